@@ -20,6 +20,9 @@ LM75B::LM75B(PinName sda, PinName scl, Address addr) : m_I2C(sda, scl)
 {
     //Set the internal device address
     m_Addr = (int)addr;
+
+    //The pointer register is unknown until it has been written
+    m_Pointer = REG_UNKNOWN;
 }
 
 bool LM75B::open(void)
@@ -181,6 +184,12 @@ void LM75B::alertHyst(float temp)
 }
 
 float LM75B::temp(void)
+{
+    //Return the temperature in °C
+    return temp_raw() * 0.125;
+}
+
+short LM75B::temp_raw(void)
 {
     //Signed return value
     short value;
@@ -192,14 +201,27 @@ float LM75B::temp(void)
     if (value & (1 << 10))
         value |= 0xFC00;
 
-    //Return the temperature in °C
-    return value * 0.125;
+    //Return the temperature in 0.125°C units
+    return value;
+}
+
+void LM75B::selectReg(char reg)
+{
+    //The LM75B keeps its pointer between reads, so only write it when it changes
+    if (m_Pointer == reg)
+        return;
+
+    //Select the register (forget the pointer if the write was not acknowledged)
+    if (!m_I2C.write(m_Addr, &reg, 1))
+        m_Pointer = reg;
+    else
+        m_Pointer = REG_UNKNOWN;
 }
 
 char LM75B::read8(char reg)
 {
     //Select the register
-    m_I2C.write(m_Addr, &reg, 1);
+    selectReg(reg);
 
     //Read the 8-bit register
     m_I2C.read(m_Addr, &reg, 1);
@@ -217,8 +239,8 @@ void LM75B::write8(char reg, char data)
     buff[0] = reg;
     buff[1] = data;
 
-    //Write the data
-    m_I2C.write(m_Addr, buff, 2);
+    //Write the data (this also moves the pointer to reg)
+    m_Pointer = m_I2C.write(m_Addr, buff, 2) ? REG_UNKNOWN : reg;
 }
 
 unsigned short LM75B::read16(char reg)
@@ -227,13 +249,13 @@ unsigned short LM75B::read16(char reg)
     char buff[2];
 
     //Select the register
-    m_I2C.write(m_Addr, &reg, 1);
+    selectReg(reg);
 
     //Read the 16-bit register
     m_I2C.read(m_Addr, buff, 2);
 
-    //Return the combined 16-bit value
-    return (buff[0] << 8) | buff[1];
+    //Return the combined 16-bit value (bytes taken as unsigned, char is signed on some compilers)
+    return ((unsigned char)buff[0] << 8) | (unsigned char)buff[1];
 }
 
 void LM75B::write16(char reg, unsigned short data)
@@ -246,8 +268,8 @@ void LM75B::write16(char reg, unsigned short data)
     buff[1] = data >> 8;
     buff[2] = data;
 
-    //Write the data
-    m_I2C.write(m_Addr, buff, 3);
+    //Write the data (this also moves the pointer to reg)
+    m_Pointer = m_I2C.write(m_Addr, buff, 3) ? REG_UNKNOWN : reg;
 }
 
 float LM75B::readAlertTempHelper(char reg)
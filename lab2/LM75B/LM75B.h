@@ -189,6 +189,12 @@ public:
      */
     float temp(void);
 
+    /** Get the current temperature measurement of the LM75B without float math
+     *
+     * @returns The current temperature measurement as a signed 11-bit value in units of 0.125°C.
+     */
+    short temp_raw(void);
+
 #ifdef MBED_OPERATORS
     /** A shorthand for temp()
      *
@@ -205,14 +211,17 @@ private:
         REG_TEMP    = 0x00,
         REG_CONF    = 0x01,
         REG_THYST   = 0x02,
-        REG_TOS     = 0x03
+        REG_TOS     = 0x03,
+        REG_UNKNOWN = 0xFF
     };
 
     //Member variables
     I2C m_I2C;
     int m_Addr;
+    char m_Pointer;
 
     //Internal functions
+    void selectReg(char reg);
     char read8(char reg);
     void write8(char reg, char data);
     unsigned short read16(char reg);
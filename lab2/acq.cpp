@@ -0,0 +1,216 @@
+#include "mbed.h"
+#include "acq.h"
+
+// I2C control register bits (I2CONSET/I2CONCLR)
+#define I2C_AA  0x04
+#define I2C_SI  0x08
+#define I2C_STO 0x10
+#define I2C_STA 0x20
+
+#define ADC_CHANNEL 4        // p19 = AD0.4
+#define IRQ_PRIORITY 12      // below configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, so FromISR calls are allowed
+
+static TaskHandle_t xAcqTask;
+static uint8_t addr[ACQ_MAX_SENSORS];   // LM75B addresses, read in this order
+static uint8_t naddr;
+static volatile uint8_t k;              // sensor being read
+static volatile uint8_t buff[ACQ_MAX_SENSORS][2]; // temperature registers (MSB, LSB)
+static volatile uint8_t read_ok;        // bit k set if sensor k answered
+static volatile uint16_t adc_value;     // last single conversion, scaled to 16 bits
+static volatile bool i2c_error;
+static uint8_t started;                 // ACQ_TEMP/ACQ_LUM started by acqStart()
+
+// Luminosity filter (touched only by the ADC ISR while filtering)
+static Ticker lum_ticker;
+static volatile bool filtering = false;
+static uint32_t acc;                    // first stage accumulator
+static uint8_t nacc;                    // samples in acc
+static uint16_t taps[LUM_TAPS];         // second stage delay line
+static uint32_t taps_sum;
+static uint8_t tap;
+static bool primed;
+static volatile uint16_t lum_filtered;  // 16-bit filter output
+
+extern "C" void acqI2CHandler(void)
+{
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  
+  // Master receiver state machine: one 2-byte read per sensor, chained with repeated STARTs so
+  // the whole batch is a single bus transaction. Each LM75B pointer already selects REG_TEMP.
+  switch (LPC_I2C2->I2STAT)
+  {
+    case 0x08: // START transmitted
+    case 0x10: // repeated START transmitted: send SLA+R of the current sensor
+      LPC_I2C2->I2DAT = addr[k] | 1;
+      LPC_I2C2->I2CONCLR = I2C_STA;
+      break;
+    case 0x40: // SLA+R acknowledged: ACK the first byte
+      LPC_I2C2->I2CONSET = I2C_AA;
+      break;
+    case 0x50: // first byte received: NACK the last one
+      buff[k][0] = LPC_I2C2->I2DAT;
+      LPC_I2C2->I2CONCLR = I2C_AA;
+      break;
+    case 0x58: // last byte received
+      buff[k][1] = LPC_I2C2->I2DAT;
+      read_ok |= 1 << k;
+      // fall through: next sensor or end of batch
+    case 0x48: // SLA+R not acknowledged: skip this sensor
+      if (++k < naddr)
+        LPC_I2C2->I2CONSET = I2C_STA; // repeated START for the next sensor
+      else
+      {
+        LPC_I2C2->I2CONSET = I2C_STO;
+        NVIC_DisableIRQ(I2C2_IRQn); // give the bus back to the polled mbed driver
+        xTaskNotifyFromISR(xAcqTask, ACQ_TEMP, eSetBits, &xHigherPriorityTaskWoken);
+      }
+      break;
+    default:   // bus error or arbitration lost: abort the batch
+      LPC_I2C2->I2CONSET = I2C_STO;
+      NVIC_DisableIRQ(I2C2_IRQn);
+      i2c_error = true;
+      xTaskNotifyFromISR(xAcqTask, ACQ_TEMP, eSetBits, &xHigherPriorityTaskWoken);
+      break;
+  }
+  LPC_I2C2->I2CONCLR = I2C_SI;
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void lumFilter(uint16_t value)
+{
+  // First stage: sum LUM_DECIM samples, then output once (decimation)
+  acc += value;
+  if (++nacc < LUM_DECIM) return;
+  uint16_t out = acc >> 2; // 64 x 12 bits = 18 bits -> 16 bits
+  acc = 0;
+  nacc = 0;
+  
+  // Second stage: running sum over the last LUM_TAPS outputs
+  if (!primed)
+  {
+    // Fill the delay line with the first output, so the average doesn't ramp up from 0
+    for (uint8_t i = 0; i < LUM_TAPS; i++) taps[i] = out;
+    taps_sum = out * LUM_TAPS;
+    primed = true;
+  }
+  taps_sum = taps_sum - taps[tap] + out;
+  taps[tap] = out;
+  tap = (tap + 1) % LUM_TAPS;
+  lum_filtered = taps_sum / LUM_TAPS;
+}
+
+extern "C" void acqADCHandler(void)
+{
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  
+  // Reading the data register clears DONE; stop the converter until the next start
+  uint16_t value = (LPC_ADC->ADDR4 >> 4) & 0xFFF;
+  LPC_ADC->ADCR &= ~(7 << 24);
+  if (filtering)
+  {
+    lumFilter(value); // no task is notified, TaskSensors reads lum_filtered
+    return;
+  }
+  adc_value = (value << 4) | (value >> 8); // 12 -> 16 bits, like AnalogIn::read_u16()
+  xTaskNotifyFromISR(xAcqTask, ACQ_LUM, eSetBits, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+static void lumTick(void)
+{
+  // Start one conversion, acqADCHandler completes it
+  LPC_ADC->ADCR = (LPC_ADC->ADCR & ~(7 << 24)) | (1 << 24);
+}
+
+void acqInit(TaskHandle_t task, const uint8_t *addresses, uint8_t n)
+{
+  // Pins, clocks and dividers are already set up by the mbed I2C and AnalogIn objects
+  xAcqTask = task;
+  naddr = n;
+  for (uint8_t i = 0; i < n; i++)
+    addr[i] = addresses[i];
+  
+  NVIC_SetVector(I2C2_IRQn, (uint32_t)acqI2CHandler);
+  NVIC_SetPriority(I2C2_IRQn, IRQ_PRIORITY);
+  
+  LPC_ADC->ADINTEN = 1 << ADC_CHANNEL; // interrupt on channel done only
+  NVIC_SetVector(ADC_IRQn, (uint32_t)acqADCHandler);
+  NVIC_SetPriority(ADC_IRQn, IRQ_PRIORITY);
+  NVIC_EnableIRQ(ADC_IRQn);
+}
+
+void acqStart(uint8_t what)
+{
+  // Clear stale notifications from a previous (timed out) acquisition
+  xTaskNotifyWait(ACQ_TEMP | ACQ_LUM, ACQ_TEMP | ACQ_LUM, NULL, 0);
+  i2c_error = false;
+  read_ok = 0;
+  k = 0;
+  started = what;
+  
+  // ADC: select the channel and start now, the conversion runs in hardware (the ticker owns it while filtering)
+  if ((what & ACQ_LUM) && !filtering)
+    LPC_ADC->ADCR = (LPC_ADC->ADCR & ~(0xFF | (7 << 24))) | (1 << ADC_CHANNEL) | (1 << 24);
+  
+  // I2C: send START, the rest of the batch is driven by acqI2CHandler
+  if (!(what & ACQ_TEMP) || naddr == 0) return;
+  LPC_I2C2->I2CONCLR = I2C_SI | I2C_STA | I2C_AA;
+  NVIC_EnableIRQ(I2C2_IRQn);
+  LPC_I2C2->I2CONSET = I2C_STA;
+}
+
+bool acqWait(short *temp_raw, uint16_t *adc)
+{
+  uint32_t bits = 0, received;
+  uint32_t wanted = started & ((naddr ? ACQ_TEMP : 0) | (filtering ? 0 : ACQ_LUM));
+  TickType_t xStart = xTaskGetTickCount();
+  
+  // Sleep (no spinning) until the ISRs have notified
+  while ((bits & wanted) != wanted)
+  {
+    TickType_t elapsed = xTaskGetTickCount() - xStart;
+    if (elapsed >= pdMS_TO_TICKS(ACQ_TIMEOUT) ||
+        xTaskNotifyWait(0, ACQ_TEMP | ACQ_LUM, &received, pdMS_TO_TICKS(ACQ_TIMEOUT) - elapsed) == pdFALSE)
+    {
+      // Abort a transfer that never completed
+      NVIC_DisableIRQ(I2C2_IRQn);
+      LPC_I2C2->I2CONSET = I2C_STO;
+      LPC_I2C2->I2CONCLR = I2C_SI;
+      return false;
+    }
+    bits |= received;
+  }
+  if (i2c_error) return false;
+  
+  for (uint8_t i = 0; i < naddr && (started & ACQ_TEMP); i++)
+  {
+    if (!(read_ok & (1 << i))) continue; // sensor didn't answer: keep its previous value
+    // Same conversion as LM75B::temp_raw(): 11-bit value, sign extended
+    short value = ((buff[i][0] << 8) | buff[i][1]) >> 5;
+    if (value & (1 << 10))
+      value |= 0xFC00;
+    temp_raw[i] = value;
+  }
+  if (started & ACQ_LUM)
+    *adc = filtering ? lum_filtered : adc_value;
+  return true;
+}
+
+void acqFilter(bool on)
+{
+  if (on == filtering) return;
+  if (on)
+  {
+    // Reset the filter and let the ticker drive the ADC
+    acc = 0; nacc = 0; tap = 0; primed = false;
+    lum_filtered = adc_value;
+    LPC_ADC->ADCR = (LPC_ADC->ADCR & ~(0xFF | (7 << 24))) | (1 << ADC_CHANNEL);
+    filtering = true;
+    lum_ticker.attach_us(lumTick, LUM_RATE_US);
+  }
+  else
+  {
+    lum_ticker.detach();
+    filtering = false;
+  }
+}
@@ -0,0 +1,30 @@
+#include <cstdint>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef ACQ_H
+#define ACQ_H
+
+// Interrupt-driven acquisition (LPC1768 I2C2 on p28/p27 and ADC channel 4 on p19).
+// acqStart() launches the LM75B temperature reads (all sensors, one batch) and/or the
+// ADC conversion together; both complete in their ISRs, which notify the waiting task.
+// With the luminosity filter on, a ticker converts at LUM_RATE_US instead and
+// acqWait() returns the filter output, so only the temperature is awaited.
+
+#define ACQ_TEMP    (1 << 0) // notification bit: temperature read completed
+#define ACQ_LUM     (1 << 1) // notification bit: ADC conversion completed
+#define ACQ_TIMEOUT 10       // ms to wait for both before giving up
+#define ACQ_MAX_SENSORS 8    // LM75B ADDRESS_0 .. ADDRESS_7
+
+#define LUM_RATE_US 1000     // filter input: one conversion every ms
+#define LUM_DECIM   64       // first stage: boxcar sum of 64 samples (CIC, order 1), 12 -> 18 bits
+#define LUM_TAPS    4        // second stage: moving average of the last 4 decimated outputs
+
+void acqInit(TaskHandle_t task, const uint8_t *addresses, uint8_t n); // task to be notified, LM75B I2C addresses
+void acqStart(uint8_t what);                      // start the ACQ_TEMP/ACQ_LUM conversions (non-blocking)
+bool acqWait(short *temp_raw, uint16_t *adc);     // block until all started are done (false on timeout/bus error),
+                                                  // temp_raw[i] is left unchanged if sensor i didn't answer (or T wasn't
+                                                  // started), adc is 16-bit (unchanged if L wasn't started)
+void acqFilter(bool on);                          // oversampled and filtered luminosity on/off
+
+#endif /* ACQ_H */
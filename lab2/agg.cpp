@@ -0,0 +1,31 @@
+#include "agg.h"
+
+template <typename V, typename S>
+static void aggColumn(Agg<V, S> *a, const V *value, const uint32_t *weight, uint8_t n)
+{
+  // One pass, min/max/sums kept in locals and merged into a once (the accumulator is not re-read per sample)
+  V lo, hi;
+  S sum = 0;
+  uint64_t total = 0;
+  
+  if (n == 0) return;
+  lo = hi = value[0];
+  for (uint8_t i = 0; i < n; i++)
+  {
+    if (value[i] < lo) lo = value[i];
+    if (value[i] > hi) hi = value[i];
+    sum += (S)value[i] * weight[i]; // SMLAL/UMLAL on the M3
+    total += weight[i];
+  }
+  aggMerge(a, lo, hi, sum, total);
+}
+
+void aggT(AggT *a, const Temp *value, const uint32_t *weight, uint8_t n)
+{
+  aggColumn(a, value, weight, n);
+}
+
+void aggL(AggL *a, const uint8_t *value, const uint32_t *weight, uint8_t n)
+{
+  aggColumn(a, value, weight, n);
+}
@@ -0,0 +1,50 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef AGG_H
+#define AGG_H
+
+// Min/max/weighted-sum kernel over one column of samples (structure of arrays),
+// a plain scalar pass. A word-parallel (SWAR) min/max measured slower than it on
+// the host at every chunk size (test/test_agg.cpp), and the M3 has no SIMD to
+// make up for the packing. The accumulator is generic over the value and sum
+// types; sums and weights are 64-bit (2^32 ticks of full-scale values do not
+// overflow) and an empty accumulator is flagged, not encoded as an
+// out-of-range minimum.
+
+#define AGG_CHUNK 8   // samples gathered per column before running the kernel
+
+template <typename V, typename S>
+struct Agg
+{
+  V min;
+  V max;
+  S sum;           // sum of value x weight
+  uint64_t weight;
+  bool empty;      // no samples: min, max and sum are meaningless
+};
+
+typedef Agg<Temp, int64_t> AggT;
+typedef Agg<uint8_t, uint64_t> AggL;
+
+template <typename V, typename S>
+inline void aggInit(Agg<V, S> *a)
+{
+  a->min = 0; a->max = 0; a->sum = 0; a->weight = 0; a->empty = true;
+}
+
+// Folds a block that is already reduced (a kernel chunk, a rollup bucket) into a
+template <typename V, typename S>
+inline void aggMerge(Agg<V, S> *a, V min, V max, S sum, uint64_t weight)
+{
+  if (a->empty || min < a->min) a->min = min;
+  if (a->empty || max > a->max) a->max = max;
+  a->sum += sum;
+  a->weight += weight;
+  a->empty = false;
+}
+
+void aggT(AggT *a, const Temp *value, const uint32_t *weight, uint8_t n);
+void aggL(AggL *a, const uint8_t *value, const uint32_t *weight, uint8_t n);
+
+#endif /* AGG_H */
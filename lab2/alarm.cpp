@@ -0,0 +1,194 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timebase.h"
+#include "alarm.h"
+
+static AlarmTable table[2];
+static AlarmTable *volatile current = &table[0]; // read once per pass
+static AlarmTable *edit;
+
+// Evaluator state (TaskSensors only), per rule of the current table
+static uint16_t seen = 0;
+static uint8_t count[ALARM_RULES]; // consecutive samples at or above the threshold
+static bool raised[ALARM_RULES];
+
+// Clock alarms, min-heap on the deadline
+typedef struct
+{
+  Tick at;
+  Time time;
+} Deadline;
+
+static Deadline heap[ALARM_CLOCKS];
+static uint8_t nheap = 0;
+
+void alarmInit(Temp t, uint8_t l)
+{
+  // Same behaviour as the former hand-coded checks: T released 1 °C lower (as the LM75B THYST),
+  // L on every sample at or above its threshold
+  AlarmRule rt = {CH_TEMP, 1, 1, ALARM_ALL, t, TEMP_C(1)};
+  AlarmRule rl = {CH_LUM, 0, 1, ALARM_ALL, l, 0};
+  
+  table[0].n = 2;
+  table[0].rule[0] = rt;
+  table[0].rule[1] = rl;
+}
+
+const AlarmTable *alarmRules(void)
+{
+  return current;
+}
+
+AlarmTable *alarmEdit(void)
+{
+  edit = current == &table[0] ? &table[1] : &table[0];
+  *edit = *current;
+  return edit;
+}
+
+void alarmPublish(void)
+{
+  edit->version = current->version + 1;
+  // CRITICAL SECTION: also a compiler barrier, the copy is complete before it is visible
+  taskENTER_CRITICAL();
+  current = edit;
+  taskEXIT_CRITICAL();
+  // END OF CRITICAL SECTION
+}
+
+bool alarmArmed(uint8_t channel)
+{
+  const AlarmTable *rules = current;
+  
+  for (uint8_t i = 0; i < rules->n; i++)
+    if (rules->rule[i].channel == channel) return 1;
+  return 0;
+}
+
+int16_t alarmLowest(uint8_t channel)
+{
+  const AlarmTable *rules = current;
+  int16_t lowest = TEMP_MAX;
+  
+  for (uint8_t i = 0; i < rules->n; i++)
+    if (rules->rule[i].channel == channel && rules->rule[i].threshold < lowest) lowest = rules->rule[i].threshold;
+  return lowest;
+}
+
+void alarmEvaluate(const Temp *temp, uint8_t n, uint8_t lum, int16_t rate, uint8_t channels, uint8_t fired[ALARM_CHANNELS])
+{
+  const AlarmTable *a = current;
+  int16_t value[ALARM_CHANNELS];
+  
+  value[CH_TEMP] = -TEMP_MAX;
+  for (uint8_t c = 0; c < n; c++)
+    if (temp[c] > value[CH_TEMP]) value[CH_TEMP] = temp[c];
+  value[CH_LUM] = lum;
+  value[ALARM_RATE] = rate;
+  if (channels & (1 << CH_TEMP)) channels |= 1 << ALARM_RATE; // updated with every T sample
+  memset(fired, 0, ALARM_CHANNELS);
+  if (a->version != seen)
+  {
+    memset(count, 0, sizeof(count));
+    memset(raised, 0, sizeof(raised));
+    seen = a->version;
+  }
+  
+  for (uint8_t i = 0; i < a->n; i++)
+  {
+    const AlarmRule *r = &a->rule[i];
+    int16_t v = value[r->channel];
+    if (!(channels & (1 << r->channel))) continue; // not sampled this time
+    if (raised[i])
+    {
+      if (v < r->threshold - r->hysteresis) { raised[i] = 0; count[i] = 0; }
+      else if (!r->edge) fired[r->channel] |= r->action;
+      continue;
+    }
+    if (v < r->threshold) { count[i] = 0; continue; }
+    if (++count[i] < r->debounce) continue;
+    raised[i] = 1;
+    fired[r->channel] |= r->action;
+  }
+}
+
+static void siftUp(uint8_t i)
+{
+  Deadline d = heap[i];
+  for (; i > 0 && heap[(i - 1) / 2].at > d.at; i = (i - 1) / 2)
+    heap[i] = heap[(i - 1) / 2];
+  heap[i] = d;
+}
+
+static void siftDown(uint8_t i)
+{
+  Deadline d = heap[i];
+  uint8_t k;
+  for (; (k = 2 * i + 1) < nheap; i = k)
+  {
+    if (k + 1 < nheap && heap[k + 1].at < heap[k].at) k++;
+    if (heap[k].at >= d.at) break;
+    heap[i] = heap[k];
+  }
+  heap[i] = d;
+}
+
+bool alarmClockAdd(Time time)
+{
+  if (nheap == ALARM_CLOCKS) return false;
+  heap[nheap].at = wallNext(time);
+  heap[nheap].time = time;
+  siftUp(nheap++);
+  return true;
+}
+
+void alarmClockClear(void)
+{
+  nheap = 0;
+}
+
+void alarmClockRebase(void)
+{
+  // Every deadline moves by a different amount (times wrap at midnight): rebuild
+  for (uint8_t i = 0; i < nheap; i++)
+    heap[i].at = wallNext(heap[i].time);
+  for (uint8_t i = nheap / 2; i-- > 0; )
+    siftDown(i);
+}
+
+Tick alarmClockNext(void)
+{
+  return nheap > 0 ? heap[0].at : TICK_INVALID;
+}
+
+uint8_t alarmClockDue(Tick now)
+{
+  uint8_t due = 0;
+  
+  while (nheap > 0 && heap[0].at <= now)
+  {
+    heap[0].at += TICKS_PER_DAY; // same time tomorrow
+    siftDown(0);
+    due++;
+  }
+  return due;
+}
+
+uint8_t alarmClockList(Time time[ALARM_CLOCKS])
+{
+  Deadline saved[ALARM_CLOCKS];
+  uint8_t n = nheap;
+  
+  // Pop a copy of the heap
+  memcpy(saved, heap, sizeof(heap));
+  for (uint8_t i = 0; i < n; i++)
+  {
+    time[i] = heap[0].time;
+    heap[0] = heap[--nheap];
+    siftDown(0);
+  }
+  memcpy(heap, saved, sizeof(heap));
+  nheap = n;
+  return n;
+}
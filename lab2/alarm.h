@@ -0,0 +1,60 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef ALARM_H
+#define ALARM_H
+
+// Threshold alarms as a rule table, evaluated in one pass per sample by
+// TaskSensors. The table is read-copy-update: the console edits a copy and
+// publishes it with a single pointer store, so the evaluator never takes a
+// mutex. The evaluator runs above the console and never blocks while it reads
+// the table, so a copy is never edited while a pass is still reading it.
+//
+// Clock alarms are daily wall clock times kept as absolute tick deadlines in
+// a min-heap; the caller arms a one-shot timer for the earliest one, so
+// nothing is compared every second. The heap is protected by xAlarmMutex.
+
+#define ALARM_RULES 8
+#define ALARM_RATE NCH  // rule channel of the T rate of change (see trend.h)
+#define ALARM_CHANNELS (NCH + 1)
+#define ALARM_CLOCKS 8
+
+// Actions of a rule (flags)
+#define ALARM_LCD    0x1 // letter on the LCD (T, L, R)
+#define ALARM_TLM    0x2 // telemetry frame
+#define ALARM_BUZZER 0x4 // TaskAlarm sounds for tala seconds
+#define ALARM_ALL    0x7
+
+typedef struct
+{
+  uint8_t channel;    // CH_TEMP (highest T sensor), CH_LUM or ALARM_RATE (fastest T sensor, either way)
+  uint8_t edge;       // 1 --> fire when raised, 0 --> fire on every sample while raised (level)
+  uint8_t debounce;   // consecutive samples at or above the threshold to raise (at least 1)
+  uint8_t action;     // ALARM_* flags
+  int16_t threshold;  // raised at value >= threshold (Temp for CH_TEMP, 0..3 for CH_LUM, tenths of °C per minute for ALARM_RATE)
+  int16_t hysteresis; // released at value < threshold - hysteresis
+} AlarmRule;
+
+typedef struct
+{
+  uint16_t version; // bumped on every publish, resets the debounce and raised states
+  uint8_t n;
+  AlarmRule rule[ALARM_RULES];
+} AlarmTable;
+
+void alarmInit(Temp t, uint8_t l); // rule 0: T >= t (edge), rule 1: L >= l (level)
+const AlarmTable *alarmRules(void);
+AlarmTable *alarmEdit(void);       // console only: copy of the current rules to modify,
+void alarmPublish(void);           // then made current
+bool alarmArmed(uint8_t channel);  // some rule watches channel
+int16_t alarmLowest(uint8_t channel); // lowest threshold of the rules on channel (TEMP_MAX if none)
+void alarmEvaluate(const Temp *temp, uint8_t n, uint8_t lum, int16_t rate, uint8_t channels, uint8_t fired[ALARM_CHANNELS]); // fired: actions per channel
+
+bool alarmClockAdd(Time time);             // daily at time, false if the heap is full
+void alarmClockClear(void);
+void alarmClockRebase(void);               // the wall clock was set: deadlines recomputed
+Tick alarmClockNext(void);                 // earliest deadline (TICK_INVALID if none)
+uint8_t alarmClockDue(Tick now);           // deadlines up to now, each moved to the next day
+uint8_t alarmClockList(Time time[ALARM_CLOCKS]); // in firing order
+
+#endif /* ALARM_H */
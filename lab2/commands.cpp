@@ -1,6 +1,8 @@
 #include <cstdint>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include "FreeRTOS.h"
 #include "portmacro.h"
 #include "queue.h"
@@ -8,7 +10,24 @@
 #include "semphr.h"
 #include "C12832.h"
 #include "shared.h" // custom header for shared objects
+#include "fmt.h"    // printf-free formatting
+#include "acq.h"    // interrupt-driven sensor acquisition
+#include "timebase.h" // monotonic 64-bit tick and wall clock offset
+#include "rollup.h"   // minute/hour buckets of the record history
+#include "store.h"    // record ring storage (structure of arrays)
+#include "alarm.h"    // threshold alarm rules
+#include "query.h"    // standing sliding-window queries
+#include "trend.h"    // EWMA and least-squares slope of T
+#include "wire.h"     // byte layout of records on the serial link
+#include "parse.h"    // hh:mm:ss arguments
 
+#define EXPORT_CHUNK 4 // records copied per buffer lock (kept small, the console task stack is 2*configMINIMAL_STACK_SIZE)
+#define XON  0x11      // host flow control: resume export
+#define XOFF 0x13      // host flow control: pause export
+#define XOFF_TIMEOUT_MS 10000 // a paused export resumes on its own if XON never comes
+#define ARM_WAIT_MS 100 // wait for room in the timer command queue (the daemon never blocks, it drains quickly)
+
+extern Serial pc;
 extern C12832 lcd;
 extern PwmOut r, b;
 extern BusOut leds;
@@ -17,29 +36,43 @@ extern TaskHandle_t xSensorTimer, xProcessingTimer;
 
 extern QueueHandle_t xSensorInputQueue, xSensorOutputQueue, xProcessingQueue, xProcessingInputQueue, xProcessingOutputQueue;
 
-extern SemaphoreHandle_t xClockMutex, xPrintingMutex, xBufferMutex, xAlarmMutex, xParamMutex;
+extern SemaphoreHandle_t xPrintingMutex, xSerialMutex, xBufferMutex, xAlarmMutex, xParamMutex, xI2CMutex;
 
-extern uint8_t hours, minutes, seconds;
-extern uint8_t pmon, tala, pproc; 
-extern uint8_t alah, alam, alas, alat, alal;
-extern bool alaf;
+extern uint32_t period[NCH], misses[NCH];
+extern uint8_t tala, pproc; 
+extern uint8_t alat, alal;
+extern bool alaf, oneshot, lum_filter;
+extern Temp hyst_t;
+extern uint8_t hyst_l;
+extern uint16_t heartbeat;
+extern bool subscribed;
+extern uint16_t tlm_sent, tlm_drops;
 extern uint8_t nr, wi, ri;
-extern Record records[NR];
-const Time invalid = {INVALID, INVALID, INVALID};
+extern uint8_t nts;
+extern uint32_t nw;
+
+int pushback = -1; // byte read ahead by flowControl, my_fgets takes it first (-1: none)
 
-bool splitTime(char *arg, Time *time);
-bool compareTime(Time *time1, Time *time2);
+extern void cprintf(const char* format, ...);
+extern void cputs(const char* s);
+extern void setTempThreshold(Temp t);
+extern bool armClockAlarm(TickType_t wait);
+extern void setSensorPower(bool awake);
+uint32_t firstRecord(short i);
+uint8_t readRecords(uint32_t *seq, Record *chunk, uint8_t n);
+void flowControl(void);
+void publishRules(void);
+void printOutput(OutputData *output);
+char* fmtStamp(char *buf, Tick stamp);
 
 /*-------------------------------------------------------------------------+
 | Function: cmd_rc  - read clock
 +--------------------------------------------------------------------------*/ 
 void cmd_rc (int argc, char** argv) 
 {
-  // CRITICAL SECTION
-  xSemaphoreTake(xClockMutex, portMAX_DELAY);
-  printf("\nCurrent clock: %02d:%02d:%02d\n", hours, minutes, seconds);
-  xSemaphoreGive(xClockMutex);
-  // END OF CRITICAL SECTION
+  Time time = wallTime(tickNow(), NULL); // no clock lock, derived from the tick count
+  
+  cprintf("\nCurrent clock: %02d:%02d:%02d\n", (int)(time / 3600), (int)(time / 60 % 60), (int)(time % 60));
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_sc  - set clock
@@ -49,44 +82,76 @@ void cmd_sc (int argc, char** argv)
   if (argc == 2)
   {
     Time time;
-    if (splitTime(argv[1], &time)) // split hh:mm:ss and check if time is consistent
+    if (parseTime(argv[1], &time)) // parse hh:mm:ss and check if time is consistent
     {
-      // CRITICAL SECTION
-      xSemaphoreTake(xClockMutex, portMAX_DELAY);
-      hours = (uint8_t)time.hours;
-      minutes = (uint8_t)time.minutes;
-      seconds = (uint8_t)time.seconds;
-      xSemaphoreGive(xClockMutex);
-      //END OF CRITICAL SECTION
-      printf("\nClock correctly set!\n");
+      bool armed;
+      setWallTime(time);     // the display, rc and record timestamps all follow the new offset
+      // CRITICAL SECTION: clock alarm deadlines follow the new clock
+      xSemaphoreTake(xAlarmMutex, portMAX_DELAY);
+      alarmClockRebase();
+      armed = armClockAlarm(pdMS_TO_TICKS(ARM_WAIT_MS));
+      xSemaphoreGive(xAlarmMutex);
+      // END OF CRITICAL SECTION
+      cprintf("\nClock correctly set!\n");
+      if (!armed) cprintf("\nClock alarm timer busy, alarms keep their old deadline!\n");
     }
-    else printf("\nInvalid time format!\n");
+    else cprintf("\nInvalid time format!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_rtl - read temperature and luminosity
 +--------------------------------------------------------------------------*/ 
 void cmd_rtl (int argc, char** argv) 
 {
-  Sender sender = CONSOLE;
+  SensorRequest request = {CONSOLE, CH_ALL};
   Sensor values;
+  char buf[40 + NTS * 8], *p;
 
   // Unblock TaskSensors
-  xQueueSend(xSensorInputQueue, (void*)&sender, portMAX_DELAY);
+  xQueueSend(xSensorInputQueue, (void*)&request, portMAX_DELAY);
   // Receive data (returned value not checked because portMAX_DELAY is used)
   xQueueReceive(xSensorOutputQueue, &values, portMAX_DELAY);
-  // Display read values
-  printf("\nTemperature = %u °C, Luminosity = %u\n", values.temp, values.lum);
+  // Display read values (one write: a telemetry frame never splits the line)
+  p = fmtStr(buf, "\nTemperature =");
+  for (uint8_t c = 0; c < nts; c++)
+    p = fmtQ3(fmtStr(p, " "), values.temp[c]);
+  p = fmtUint(fmtStr(p, " °C, Luminosity = "), values.lum);
+  fmtStr(fmtUint(fmtStr(p, " ("), values.lum16), ")\n");
+  cputs(buf);
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_rtr - read temperature trend (EWMA, slope over the last TREND_N samples)
++--------------------------------------------------------------------------*/ 
+void cmd_rtr (int argc, char** argv) 
+{
+  Temp ewma[NTS];
+  int16_t rate[NTS];
+  char buf[48], *p;
+  
+  trendRead(ewma, rate, nts);
+  for (uint8_t c = 0; c < nts; c++)
+  {
+    p = fmtStr(fmtUint(fmtStr(buf, "\nT"), c), ": EWMA ");
+    p = fmtStr(fmtQ3(p, ewma[c]), " °C, slope ");
+    fmtStr(fmtTenths(p, rate[c]), " °C/min");
+    cputs(buf);
+  }
+  cprintf("\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_rp  - read parameters (pmon, tala, pproc)
 +--------------------------------------------------------------------------*/ 
 void cmd_rp (int argc, char** argv) 
 {
+  char buf[FMT_UINT_LEN + 2];
+  
   // CRITICAL SECTION
   xSemaphoreTake(xParamMutex, portMAX_DELAY);
-  printf("\nPMON = %u, TALA = %u, PPROC = %u seconds\n", pmon, tala, pproc);
+  cprintf("\nPMON T = %lu, L = %lu ms, TALA = %u, PPROC = %u seconds, one-shot = %u, L filter = %u\n",
+         (unsigned long)period[CH_TEMP], (unsigned long)period[CH_LUM], tala, pproc, oneshot, lum_filter);
+  fmtQ3(buf, hyst_t);
+  cprintf("Change-driven logging: T = %s °C, L = %u, heartbeat = %u seconds\n", buf, hyst_l, heartbeat);
   xSemaphoreGive(xParamMutex);
   // END OF CRITICAL SECTION
 }
@@ -95,36 +160,61 @@ void cmd_rp (int argc, char** argv)
 +--------------------------------------------------------------------------*/ 
 void cmd_mmp (int argc, char** argv) 
 {
-  eTaskState TimerState = eTaskGetState(xSensorTimer);
-  
   if (argc == 2)
   {
     short s = atoi(argv[1]);
     if (s >= 0 && s < 60) // check seconds
     {
-      // CRITICAL SECTION: change priority to avoid this task being preempted before suspending/resuming the timer
-      // (The mutex will only guarantee pmon will not be modified by others, not correct suspend/resume)
-      vTaskPrioritySet(NULL, 4); // NULL refers to current task
       // CRITICAL SECTION
       xSemaphoreTake(xParamMutex, portMAX_DELAY);
-      pmon = (uint8_t)s;
-      // Suspend TaskSensorTimer if pmon is 0
-      if (pmon == 0)
-        vTaskSuspend(xSensorTimer);
-      // Resume TaskSensorTimer if pmon is not 0 and task was previously suspended
-      else
-      {
-        if (TimerState == eSuspended)
-          vTaskResume(xSensorTimer);
-      }
+      for (uint8_t c = 0; c < NCH; c++)
+        period[c] = 1000 * s; // same period for every channel
       xSemaphoreGive(xParamMutex);
-      printf("\nMonitoring period correctly set!\n");
-      vTaskPrioritySet(NULL, 1);
       // END OF CRITICAL SECTION
+      xTaskNotifyGive(xSensorTimer); // reschedule now (a period of 0 stops the channel)
+      cprintf("\nMonitoring period correctly set!\n");
+    }
+    else cprintf("\nInvalid seconds!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_msp - modify sampling period of one channel (T/L, ms - 0 deactivate)
++--------------------------------------------------------------------------*/ 
+void cmd_msp (int argc, char** argv) 
+{
+  if (argc == 3)
+  {
+    char c = toupper(argv[1][0]);
+    long ms = atol(argv[2]);
+    if ((c == 'T' || c == 'L') && argv[1][1] == '\0') // check channel
+    {
+      if (ms == 0 || (ms >= SAMPLE_MIN_MS && ms <= 60000)) // check period
+      {
+        // CRITICAL SECTION
+        xSemaphoreTake(xParamMutex, portMAX_DELAY);
+        period[c == 'T' ? CH_TEMP : CH_LUM] = ms;
+        xSemaphoreGive(xParamMutex);
+        // END OF CRITICAL SECTION
+        xTaskNotifyGive(xSensorTimer); // reschedule now
+        cprintf("\nSampling period correctly set!\n");
+      }
+      else cprintf("\nInvalid period!\n");
     }
-    else printf("\nInvalid seconds!\n");
+    else cprintf("\nInvalid channel!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_rdm - read missed sampling deadlines (T, L)
++--------------------------------------------------------------------------*/ 
+void cmd_rdm (int argc, char** argv) 
+{
+  // CRITICAL SECTION
+  xSemaphoreTake(xParamMutex, portMAX_DELAY);
+  cprintf("\nMissed deadlines: T = %lu, L = %lu\n", (unsigned long)misses[CH_TEMP], (unsigned long)misses[CH_LUM]);
+  xSemaphoreGive(xParamMutex);
+  // END OF CRITICAL SECTION
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_mta - modify time alarm (seconds)
@@ -141,11 +231,11 @@ void cmd_mta (int argc, char** argv)
       tala = (uint8_t)s;
       xSemaphoreGive(xParamMutex);
       // END OF CRITICAL SECTION
-      printf("\nAlarm time correctly set!\n");
+      cprintf("\nAlarm time correctly set!\n");
     }
-    else printf("\nInvalid seconds!\n");
+    else cprintf("\nInvalid seconds!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_mpp - modify processing period (seconds - 0 deactivate)
@@ -179,25 +269,129 @@ void cmd_mpp (int argc, char** argv)
           vTaskResume(xProcessingTimer);
       }
       xSemaphoreGive(xParamMutex);
-      printf("\nMonitoring period correctly set!\n");
+      cprintf("\nMonitoring period correctly set!\n");
       //vTaskPrioritySet(NULL, 4);
       // END OF CRITICAL SECTION
     }
-    else printf("\nInvalid seconds!\n");
+    else cprintf("\nInvalid seconds!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_mpm - modify sensor power mode (1 - one-shot, 0 - continuous)
++--------------------------------------------------------------------------*/ 
+void cmd_mpm (int argc, char** argv) 
+{
+  if (argc == 2)
+  {
+    short s = atoi(argv[1]);
+    if (s == 0 || s == 1)
+    {
+      // CRITICAL SECTION
+      xSemaphoreTake(xParamMutex, portMAX_DELAY);
+      oneshot = s;
+      xSemaphoreGive(xParamMutex);
+      // END OF CRITICAL SECTION
+      if (!s)
+      {
+        // CRITICAL SECTION: back to continuous conversion, the LM75B may be shut down
+        xSemaphoreTake(xI2CMutex, portMAX_DELAY);
+        setSensorPower(1);
+        xSemaphoreGive(xI2CMutex);
+        // END OF CRITICAL SECTION
+      }
+      cprintf("\nPower mode correctly set!\n");
+    }
+    else cprintf("\nInvalid value!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_mlf - modify luminosity filter (1 - oversampled, 0 - single sample)
++--------------------------------------------------------------------------*/ 
+void cmd_mlf (int argc, char** argv) 
+{
+  if (argc == 2)
+  {
+    short s = atoi(argv[1]);
+    if (s == 0 || s == 1)
+    {
+      // CRITICAL SECTION: don't switch the ADC owner in the middle of an acquisition
+      xSemaphoreTake(xI2CMutex, portMAX_DELAY);
+      lum_filter = s;
+      acqFilter(s);
+      xSemaphoreGive(xI2CMutex);
+      // END OF CRITICAL SECTION
+      cprintf("\nLuminosity filter correctly set!\n");
+    }
+    else cprintf("\nInvalid value!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_mcd - modify change-driven logging (T tenths of °C, L, heartbeat seconds - 0 deactivate)
++--------------------------------------------------------------------------*/ 
+void cmd_mcd (int argc, char** argv) 
+{
+  if (argc == 4)
+  {
+    short t = atoi(argv[1]), l = atoi(argv[2]);
+    long s = atol(argv[3]);
+    if (t >= 0 && t <= 100 && l >= 0 && l <= 3) // check hysteresis (up to 10 °C, L is 0..3)
+    {
+      if (s >= 0 && s <= 3600) // check heartbeat
+      {
+        // CRITICAL SECTION
+        xSemaphoreTake(xParamMutex, portMAX_DELAY);
+        hyst_t = (TEMP_C(t) + 5) / 10; // tenths of °C to Q3
+        hyst_l = (uint8_t)l;
+        heartbeat = (uint16_t)s;
+        xSemaphoreGive(xParamMutex);
+        // END OF CRITICAL SECTION
+        cprintf("\nChange-driven logging correctly set!\n");
+      }
+      else cprintf("\nInvalid seconds!\n");
+    }
+    else cprintf("\nInvalid hysteresis!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_rai - read alarm info (clock, temperature, luminosity, active/inactive-A/a)
 +--------------------------------------------------------------------------*/ 
 void cmd_rai (int argc, char** argv) 
 {
+  const AlarmTable *rules = alarmRules(); // the console is the only writer
+  char buf[72], *p;
+  Time clocks[ALARM_CLOCKS];
+  uint8_t n;
+  
   // CRITICAL SECTION
   xSemaphoreTake(xAlarmMutex, portMAX_DELAY);
-  printf("\nALAH = %u, ALAM = %u, ALAS = %u\n", alah, alam, alas);
-  printf("ALAT = %u, ALAL = %u, ALAF = %c\n", alat, alal, alaf ? 'A' : 'a');
+  n = alarmClockList(clocks);
+  cprintf("\nALAT = %u, ALAL = %u, ALAF = %c\n", alat, alal, alaf ? 'A' : 'a');
   xSemaphoreGive(xAlarmMutex);
   // END OF CRITICAL SECTION
+  p = fmtStr(buf, n == 0 ? "Clock alarms: none" : "Clock alarms:");
+  for (uint8_t i = 0; i < n; i++)
+    p = fmtTime(fmtStr(p, " "), clocks[i] / 3600, clocks[i] / 60 % 60, clocks[i] % 60);
+  fmtStr(p, "\n");
+  cputs(buf);
+  for (uint8_t i = 0; i < rules->n; i++)
+  {
+    const AlarmRule *rule = &rules->rule[i];
+    p = fmtStr(fmtUint(buf, i), rule->channel == CH_TEMP ? ": T >= " : rule->channel == CH_LUM ? ": L >= " : ": |dT/dt| >= ");
+    if (rule->channel == CH_TEMP)
+      p = fmtQ3(fmtStr(fmtQ3(p, rule->threshold), ", hyst "), rule->hysteresis);
+    else if (rule->channel == ALARM_RATE)
+      p = fmtStr(fmtTenths(fmtStr(fmtTenths(p, rule->threshold), " °C/min, hyst "), rule->hysteresis), " °C/min");
+    else
+      p = fmtUint(fmtStr(fmtUint(p, rule->threshold), ", hyst "), rule->hysteresis);
+    p = fmtStr(p, rule->edge ? ", edge" : ", level");
+    p = fmtUint(fmtStr(p, ", debounce "), rule->debounce);
+    fmtUint(fmtStr(p, ", action "), rule->action);
+    cprintf("%s\n", buf);
+  }
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_dac - define alarm clock
@@ -207,20 +401,23 @@ void cmd_dac (int argc, char** argv)
   if (argc == 2)
   {
     Time time;
-    if (splitTime(argv[1], &time)) // split hh:mm:ss and check if time is consistent
+    if (parseTime(argv[1], &time)) // parse hh:mm:ss and check if time is consistent
     {
+      bool added = 1, armed;
       // CRITICAL SECTION
       xSemaphoreTake(xAlarmMutex, portMAX_DELAY);
-      alah = (uint8_t)time.hours;
-      alam = (uint8_t)time.minutes;
-      alas = (uint8_t)time.seconds;
+      if (time == 0) alarmClockClear(); // 00:00:00 clears every clock alarm
+      else added = alarmClockAdd(time);
+      armed = armClockAlarm(pdMS_TO_TICKS(ARM_WAIT_MS));
       xSemaphoreGive(xAlarmMutex);
       // END OF CRITICAL SECTION
-      printf("\nClock threshold correctly set!\n");
+      if (!added) cprintf("\nToo many clock alarms!\n");
+      else if (!armed) cprintf("\nClock alarm timer busy, try again!\n");
+      else cprintf("\nClock threshold correctly set!\n");
     }
-    else printf("\nInvalid time format!\n");
+    else cprintf("\nInvalid time format!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_dtl - define alarm temperature and luminosity
@@ -240,13 +437,116 @@ void cmd_dtl (int argc, char** argv)
         alal = (uint8_t)l;
         xSemaphoreGive(xAlarmMutex);
         // END OF CRITICAL SECTION
-        printf("\nSensor thresholds correctly set!\n");
+        // First T and L alarm rules (rate rules keep their own threshold, see dra)
+        AlarmTable *rules = alarmEdit();
+        bool seen[ALARM_CHANNELS] = {0};
+        for (uint8_t i = 0; i < rules->n; i++)
+        {
+          AlarmRule *rule = &rules->rule[i];
+          if (rule->channel == ALARM_RATE || seen[rule->channel]) continue;
+          seen[rule->channel] = 1;
+          rule->threshold = rule->channel == CH_TEMP ? TEMP_C(t) : l;
+        }
+        publishRules();
+        cprintf("\nSensor thresholds correctly set!\n");
+      }
+      else cprintf("\nInvalid luminosity!\n");
+    }
+    else cprintf("\nInvalid temperature!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_dar - define alarm rule i (no more arguments - delete it)
++--------------------------------------------------------------------------*/ 
+void cmd_dar (int argc, char** argv) 
+{
+  if (argc == 2 || argc == 7 || argc == 8)
+  {
+    AlarmTable *rules = alarmEdit();
+    short i = atoi(argv[1]);
+    if (i >= 0 && i < rules->n + (argc > 2) && i < ALARM_RULES)
+    {
+      if (argc == 2)
+      {
+        memmove(&rules->rule[i], &rules->rule[i + 1], (rules->n - i - 1) * sizeof(AlarmRule));
+        rules->n--;
+        publishRules();
+        cprintf("\nAlarm rule correctly deleted!\n");
+        return;
+      }
+      AlarmRule rule;
+      char c = toupper(argv[2][0]), m = toupper(argv[5][0]);
+      long t = atol(argv[3]), h = atol(argv[4]), n = atol(argv[6]);
+      long a = argc == 8 ? atol(argv[7]) : ALARM_ALL;
+      rule.channel = c == 'T' ? CH_TEMP : CH_LUM;
+      if ((c == 'T' && t >= -550 && t <= 1280 && h >= 0 && h <= 100) || (c == 'L' && t >= 0 && t <= 3 && h >= 0 && h <= 3))
+      {
+        if ((m == 'E' || m == 'L') && n >= 1 && n <= 255 && a >= 1 && a <= ALARM_ALL)
+        {
+          // T in tenths of °C to Q3 (rounded half away from zero)
+          rule.threshold = c == 'T' ? (t * 8 + (t < 0 ? -5 : 5)) / 10 : t;
+          rule.hysteresis = c == 'T' ? (h * 8 + 5) / 10 : h;
+          rule.edge = m == 'E';
+          rule.debounce = (uint8_t)n;
+          rule.action = (uint8_t)a;
+          rules->rule[i] = rule;
+          if (i == rules->n) rules->n++;
+          publishRules();
+          cprintf("\nAlarm rule correctly set!\n");
+        }
+        else cprintf("\nInvalid mode, debounce or action!\n");
       }
-      else printf("\nInvalid luminosity!\n");
+      else cprintf("\nInvalid threshold or hysteresis!\n");
     }
-    else printf("\nInvalid temperature!\n");
+    else cprintf("\nInvalid rule!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_dra - define rate alarm (tenths of °C per minute, either way - 0 delete)
++--------------------------------------------------------------------------*/ 
+void cmd_dra (int argc, char** argv) 
+{
+  if (argc == 2 || argc == 3)
+  {
+    long r = atol(argv[1]), n = argc == 3 ? atol(argv[2]) : 2;
+    if (r >= 0 && r <= 1000) // check rate (up to 100 °C/min)
+    {
+      if (n >= 1 && n <= 255) // check debounce
+      {
+        AlarmTable *rules = alarmEdit();
+        uint8_t i;
+        // The first rate rule is replaced (or removed, or appended)
+        for (i = 0; i < rules->n && rules->rule[i].channel != ALARM_RATE; i++);
+        if (r == 0)
+        {
+          if (i < rules->n)
+          {
+            memmove(&rules->rule[i], &rules->rule[i + 1], (rules->n - i - 1) * sizeof(AlarmRule));
+            rules->n--;
+          }
+        }
+        else if (i < ALARM_RULES)
+        {
+          // Released at 3/4 of the rate, so the slope noise near the threshold does not retrigger it
+          AlarmRule rule = {ALARM_RATE, 1, (uint8_t)n, ALARM_ALL, (int16_t)r, (int16_t)(r / 4)};
+          rules->rule[i] = rule;
+          if (i == rules->n) rules->n++;
+        }
+        else
+        {
+          cprintf("\nToo many alarm rules!\n");
+          return;
+        }
+        publishRules();
+        cprintf("\nRate alarm correctly set!\n");
+      }
+      else cprintf("\nInvalid debounce!\n");
+    }
+    else cprintf("\nInvalid rate!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_aa  - activate/deactivate alarms (A/a)
@@ -263,14 +563,14 @@ void cmd_aa (int argc, char** argv)
       alaf = (num == 65) ? 1 : 0;
       xSemaphoreGive(xAlarmMutex);
       // END OF CRITICAL SECTION
-      printf("\nAlarm mode correctly set!\n");
+      cprintf("\nAlarm mode correctly set!\n");
     }
-    else printf("\nInvalid character!\n");
+    else cprintf("\nInvalid character!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
-| Function: cmd_cai - clear alarm info (letters CTL in LCD)
+| Function: cmd_cai - clear alarm info (letters CTLR in LCD)
 +--------------------------------------------------------------------------*/ 
 void cmd_cai (int argc, char** argv) 
 {
@@ -282,9 +582,11 @@ void cmd_cai (int argc, char** argv)
   lcd.printf(" ");
   lcd.locate(97, 2); // L
   lcd.printf(" ");
+  lcd.locate(107, 2); // R
+  lcd.printf(" ");
   xSemaphoreGive(xPrintingMutex);
   // END OF CRITICAL SECTION
-  printf("\nAlarm correctly cleared!\n");
+  cprintf("\nAlarm correctly cleared!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_ir  - information about records (NR, nr, wi, ri)
@@ -293,7 +595,7 @@ void cmd_ir (int argc, char** argv)
 {
   // CRITICAL SECTION
   xSemaphoreTake(xBufferMutex, portMAX_DELAY);
-  printf("\nNR = %u, nr = %u, wi = %u, ri = %u\n", NR, nr, wi, ri);
+  cprintf("\nNR = %u, nr = %u, wi = %u, ri = %u\n", NR, nr, wi, ri);
   xSemaphoreGive(xBufferMutex);
   // END OF CRITICAL SECTION
 }
@@ -309,18 +611,220 @@ void cmd_lr (int argc, char** argv)
     {
       if (i >= 0 && i < NR) // check i
       {
-        // CRITICAL SECTION
-        xSemaphoreTake(xBufferMutex, portMAX_DELAY);
-        for (short j = i; j < n; j++)
-          printf("\nRecord %hd: %02u:%02u:%02u %u°C, %u\n", j, records[j].hours, records[j].minutes, records[j].seconds, records[j].temperature, records[j].luminosity);
-        xSemaphoreGive(xBufferMutex);
-        // END OF CRITICAL SECTION
+        Record chunk[EXPORT_CHUNK];
+        char buf[40 + NTS * 10], *p;
+        uint32_t seq = firstRecord(i);
+        uint8_t count;
+        // Buffer is locked only while a chunk is copied, not while printing
+        while (n > 0 && (count = readRecords(&seq, chunk, n < EXPORT_CHUNK ? n : EXPORT_CHUNK)) > 0)
+        {
+          for (uint8_t j = 0; j < count; j++)
+          {
+            p = fmtStr(fmtUint(fmtStr(buf, "\nRecord "), seq + j), ": "); // same sequence number as er
+            p = fmtStamp(p, chunk[j].stamp);
+            for (uint8_t c = 0; c < nts; c++)
+              p = fmtStr(fmtQ3(fmtStr(p, " "), chunk[j].temperature[c]), "°C");
+            fmtStr(fmtUint(fmtStr(p, ", "), chunk[j].luminosity), "\n");
+            cputs(buf);
+          }
+          seq += count;
+          n -= count;
+        }
+      }
+      else cprintf("\nInvalid index!\n");
+    }
+    else cprintf("\nInvalid number of records!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_er  - export n records from index i (c - CSV, b - binary)
++--------------------------------------------------------------------------*/ 
+void cmd_er (int argc, char** argv) 
+{
+  char format = (argc > 1) ? argv[1][0] : 'c';
+  short n = (argc > 2) ? atoi(argv[2]) : NR; // default: whole buffer
+  short i = (argc > 3) ? atoi(argv[3]) : 0;  // default: from the oldest record
+  
+  if (argc > 4) { cprintf("\nInvalid number of arguments!\n"); return; }
+  if (format != 'c' && format != 'b') { cprintf("\nInvalid format!\n"); return; }
+  if (n < 0 || n > NR) { cprintf("\nInvalid number of records!\n"); return; }
+  if (i < 0 || i >= NR) { cprintf("\nInvalid index!\n"); return; }
+  
+  Record chunk[EXPORT_CHUNK];
+  char buf[32 + NTS * 8], *p;
+  uint8_t wire[WIRE_RECORD_MAX];
+  uint32_t seq = firstRecord(i);
+  uint8_t count, len, checksum;
+  
+  if (format == 'c')
+  {
+    p = fmtStr(buf, "\nseq,hh:mm:ss.mmm");
+    for (uint8_t c = 0; c < nts; c++)
+      p = fmtUint(fmtStr(p, ",T"), c);
+    fmtStr(p, ",L\n");
+    cputs(buf);
+  }
+  // Copy one chunk under the buffer lock, then send it while the writer is free to run
+  while (n > 0 && (count = readRecords(&seq, chunk, n < EXPORT_CHUNK ? n : EXPORT_CHUNK)) > 0)
+  {
+    if (format == 'c')
+    {
+      for (uint8_t j = 0; j < count; j++)
+      {
+        // One write per line: a telemetry frame never splits a CSV line
+        p = fmtStamp(fmtStr(fmtUint(buf, seq + j), ","), chunk[j].stamp);
+        for (uint8_t c = 0; c < nts; c++)
+          p = fmtQ3(fmtStr(p, ","), chunk[j].temperature[c]);
+        fmtStr(fmtUint(fmtStr(p, ","), chunk[j].luminosity), "\n");
+        cputs(buf);
+      }
+    }
+    else
+    {
+      // Frame: SOF, count, nts, count records in the wire.h layout, XOR of count, nts and records
+      checksum = count ^ nts;
+      // CRITICAL SECTION: a telemetry frame never lands inside an export frame
+      xSemaphoreTake(xSerialMutex, portMAX_DELAY);
+      pc.putc(SOF);
+      pc.putc(count);
+      pc.putc(nts);
+      for (uint8_t j = 0; j < count; j++)
+      {
+        len = wireRecord(wire, &chunk[j], nts);
+        for (uint8_t k = 0; k < len; k++)
+        {
+          pc.putc(wire[k]);
+          checksum ^= wire[k];
+        }
+      }
+      pc.putc(checksum);
+      xSemaphoreGive(xSerialMutex);
+      // END OF CRITICAL SECTION
+    }
+    seq += count;
+    n -= count;
+    flowControl();
+  }
+  // End of export: empty frame / end line
+  if (format == 'c') cprintf("#end\n");
+  else
+  {
+    // CRITICAL SECTION
+    xSemaphoreTake(xSerialMutex, portMAX_DELAY);
+    pc.putc(SOF); pc.putc(0); pc.putc(nts); pc.putc(nts);
+    xSemaphoreGive(xSerialMutex);
+    // END OF CRITICAL SECTION
+  }
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_dq  - define standing query i (last s seconds of T channel c or L, 0 - delete)
++--------------------------------------------------------------------------*/ 
+void cmd_dq (int argc, char** argv) 
+{
+  if (argc == 4)
+  {
+    short i = atoi(argv[1]);
+    long s = atol(argv[3]);
+    char c = toupper(argv[2][0]);
+    uint8_t channel = c == 'L' ? QUERY_LUM : argv[2][1] - '0';
+    if (i >= 0 && i < QUERIES)
+    {
+      if ((c == 'L' && argv[2][1] == '\0') || (c == 'T' && channel < nts && argv[2][2] == '\0'))
+      {
+        if (s >= 0 && s <= 86400) // check window (up to a day)
+        {
+          // CRITICAL SECTION
+          xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+          querySet(i, channel, (Tick)s * configTICK_RATE_HZ);
+          // Seed it from the records still in the buffer
+          for (uint8_t k = 0; k < nr && s > 0; k++)
+          {
+            Record record;
+            storeRead((wi + NR - nr + k) % NR, &record);
+            queryAdd(i, &record);
+          }
+          xSemaphoreGive(xBufferMutex);
+          // END OF CRITICAL SECTION
+          cprintf(s > 0 ? "\nQuery correctly set!\n" : "\nQuery correctly deleted!\n");
+        }
+        else cprintf("\nInvalid seconds!\n");
       }
-      else printf("\nInvalid number of records!\n");
+      else cprintf("\nInvalid channel!\n");
     }
-    else printf("\nInvalid index!\n");
+    else cprintf("\nInvalid query!\n");
   }
-  else printf("\nInvalid number of arguments!\n");
+  else cprintf("\nInvalid number of arguments!\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_rq  - read standing queries (max, min, time-weighted mean)
++--------------------------------------------------------------------------*/ 
+void cmd_rq (int argc, char** argv) 
+{
+  QueryResult result;
+  uint8_t channel;
+  Tick window;
+  bool set;
+  char buf[64], *p;
+  
+  for (uint8_t i = 0; i < QUERIES; i++)
+  {
+    // CRITICAL SECTION
+    xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+    set = queryGet(i, &channel, &window) && queryRead(i, tickNow(), &result);
+    xSemaphoreGive(xBufferMutex);
+    // END OF CRITICAL SECTION
+    if (!set) continue;
+    p = fmtUint(buf, i);
+    p = channel == QUERY_LUM ? fmtStr(p, ": L") : fmtUint(fmtStr(p, ": T"), channel);
+    p = fmtStr(p, " last ");
+    p = fmtStr(fmtUint(p, window / configTICK_RATE_HZ), " s ");
+    if (result.empty) fmtStr(p, "no records");
+    else
+    {
+      p = fmtStr(p, "(max, min, mean) = ");
+      if (channel == QUERY_LUM)
+      {
+        p = fmtStr(fmtUint(p, result.max), ", ");
+        p = fmtStr(fmtUint(p, result.min), ", ");
+        p = fmtTenths(p, result.mean);
+      }
+      else
+      {
+        p = fmtStr(fmtQ3(p, result.max), ", ");
+        p = fmtStr(fmtQ3(p, result.min), ", ");
+        p = fmtQ3(p, result.mean);
+      }
+      if (result.truncated) fmtStr(p, " (newest records only)");
+    }
+    cprintf("\n%s", buf);
+  }
+  cprintf("\n");
+}
+/*-------------------------------------------------------------------------+
+| Function: cmd_st  - subscribe/unsubscribe telemetry (1/0), no argument shows counters
++--------------------------------------------------------------------------*/ 
+void cmd_st (int argc, char** argv) 
+{
+  if (argc == 1)
+    cprintf("\nTelemetry %s, sent = %u, dropped = %u\n", subscribed ? "on" : "off", tlm_sent, tlm_drops);
+  else if (argc == 2)
+  {
+    short s = atoi(argv[1]);
+    if (s == 0 || s == 1)
+    {
+      // CRITICAL SECTION: counters are also updated by the producers
+      taskENTER_CRITICAL();
+      subscribed = s;
+      tlm_sent = 0;
+      tlm_drops = 0;
+      taskEXIT_CRITICAL();
+      // END OF CRITICAL SECTION
+      cprintf("\nTelemetry correctly %s!\n", s ? "subscribed" : "unsubscribed");
+    }
+    else cprintf("\nInvalid value!\n");
+  }
+  else cprintf("\nInvalid number of arguments!\n");
 }
 /*-------------------------------------------------------------------------+
 | Function: cmd_dr  - delete records
@@ -330,29 +834,25 @@ void cmd_dr (int argc, char** argv)
   // CRITICAL SECTION
   xSemaphoreTake(xBufferMutex, portMAX_DELAY);
   // Delete records
-  for (uint8_t i = 0; i < NR; i++)
-  {
-    records[i].hours = 0;
-    records[i].minutes = 0;
-    records[i].seconds = 0;
-    records[i].temperature = 0;
-    records[i].luminosity = 0;
-  }
+  storeClear();
+  rollupReset();
+  queryReset();
   // Clear parameters
   nr = 0;
   wi = 0;
   ri = 0;
+  nw = 0;
   xSemaphoreGive(xBufferMutex);
   // END OF CRITICAL SECTION
-  printf("\nRecord correctly deleted!\n");
+  cprintf("\nRecord correctly deleted!\n");
 }
 /*-------------------------------------------------------------------------+
-| Function: cmd_pr  - process records (max, min, mean) between instants t1 and t2 (h,m,s)
+| Function: cmd_pr  - process records (max, min, mean, stddev, percentiles) between instants t1 and t2 (h,m,s)
 +--------------------------------------------------------------------------*/ 
 void cmd_pr (int argc, char** argv) 
 {
   Time time1, time2;
-  Interval interval;
+  Interval interval;  // hh:mm:ss instants become a tick range, the latest one before now
   Sender sender = CONSOLE;
   InputData input;
   OutputData output;
@@ -360,98 +860,158 @@ void cmd_pr (int argc, char** argv)
   switch (argc)
   {
     case 1:
-      interval.time1 = invalid;
-      interval.time2 = invalid;
+      interval.start = TICK_INVALID;
+      interval.end = TICK_INVALID;
       input.interval = interval; input.sender = sender;
       // Send data
       xQueueSend(xProcessingInputQueue, (void*)&input, portMAX_DELAY);
       // Receive data
       xQueueReceive(xProcessingOutputQueue, &output, portMAX_DELAY);
-      if (output.minT == 50)
-        printf("\nNo records to be read!\n");
-      else
-      {
-        printf("\nTemperature (max, min, mean) = %u, %u, %.1f", output.maxT, output.minT, output.meanT);
-        printf("\nLuminosity (max, min, mean) = %u, %u, %.1f\n", output.maxL, output.minL, output.meanL);
-      }
+      printOutput(&output);
       break;
 
     case 2:
-      if (splitTime(argv[1], &time1)) // split hh:mm:ss and check if time is consistentif (splitTime(argv[1], &time)) // split hh:mm:ss and check if time is consistent
+      if (parseTime(argv[1], &time1)) // parse hh:mm:ss and check if time is consistent
       {
-        interval.time1 = time1;
-        interval.time2 = invalid;
+        interval.start = wallToTick(time1);
+        interval.end = TICK_INVALID;
         input.interval = interval; input.sender = sender;
         // Send data
         xQueueSend(xProcessingInputQueue, (void*)&input, portMAX_DELAY);
         // Receive data
         xQueueReceive(xProcessingOutputQueue, &output, portMAX_DELAY);
-        if (output.minT == 50)
-          printf("\nNo records to be read!\n");
-        else
-        {
-          printf("\nTemperature (max, min, mean) = %u, %u, %.1f", output.maxT, output.minT, output.meanT);
-          printf("\nLuminosity (max, min, mean) = %u, %u, %.1f\n", output.maxL, output.minL, output.meanL);
-        }
+        printOutput(&output);
       }
-      else printf("\nInvalid time format!\n");
+      else cprintf("\nInvalid time format!\n");
       break;
 
     case 3:
-      if (splitTime(argv[1], &time1) && splitTime(argv[2], &time2)) // split hh:mm:ss and check if time is consistent
+      if (parseTime(argv[1], &time1) && parseTime(argv[2], &time2)) // parse hh:mm:ss and check if time is consistent
       {
-        if (compareTime(&time1, &time2))
+        if (time2 > time1)
         {
-          interval.time1 = time1;
-          interval.time2 = time2;
+          interval.start = wallToTick(time1);
+          interval.end = interval.start + (Tick)(time2 - time1 + 1) * configTICK_RATE_HZ - 1; // whole t2 second
           input.interval = interval; input.sender = sender;
           // Send data
           xQueueSend(xProcessingInputQueue, (void*)&input, portMAX_DELAY);
           // Receive data
           xQueueReceive(xProcessingOutputQueue, &output, portMAX_DELAY);
-          if (output.minT == 50)
-            printf("\nNo records to be read!\n");
-          else
-          {
-            printf("\nTemperature (max, min, mean) = %u, %u, %.1f", output.maxT, output.minT, output.meanT);
-            printf("\nLuminosity (max, min, mean) = %u, %u, %.1f\n", output.maxL, output.minL, output.meanL);
-          }
+          printOutput(&output);
         }
-        else printf("\nInvalid time interval!\n");
+        else cprintf("\nInvalid time interval!\n");
       }
-      else printf("\nInvalid time format\n");
+      else cprintf("\nInvalid time format\n");
       break;
 
-    default: printf("\nInvalid number of arguments!\n");
+    default: cprintf("\nInvalid number of arguments!\n");
   }
 }
 /*-------------------------------------------------------------------------+
 | UTILITY
 +--------------------------------------------------------------------------*/ 
-bool splitTime(char *arg, Time *time)
+uint32_t firstRecord(short i)
 {
-  // arg must be in format "hh:mm:ss"
-  if (strlen(arg) != 8 || arg[2] != ':' || arg[5] != ':') // check if length != 8 or wrong format
-    return false;
-  else
+  uint32_t seq;
+  // CRITICAL SECTION
+  xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+  seq = nw - nr + i; // sequence number of the i-th oldest record
+  xSemaphoreGive(xBufferMutex);
+  // END OF CRITICAL SECTION
+  return seq;
+}
+
+uint8_t readRecords(uint32_t *seq, Record *chunk, uint8_t n)
+{
+  uint8_t count = 0;
+  
+  // CRITICAL SECTION: only one chunk is copied, so TaskSensors is never blocked for the whole export
+  xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+  if (*seq < nw - nr) *seq = nw - nr; // skip records overwritten since the last chunk
+  while (count < n && *seq + count < nw)
   {
-    char *token = strtok(arg, ":");
-    time->hours = atoi(token);
-    if (time->hours < 0 || time->hours > 23) return false;
-    token = strtok(NULL, ":");
-    time->minutes = atoi(token);
-    if (time->minutes < 0 || time->minutes > 59) return false;
-    token = strtok(NULL, ":");
-    time->seconds = atoi(token);
-    if (time->seconds < 0 || time->seconds > 59) return false;
+    storeRead((wi + NR - (nw - (*seq + count))) % NR, &chunk[count]);
+    count++;
   }
-  return true;
+  xSemaphoreGive(xBufferMutex);
+  // END OF CRITICAL SECTION
+  return count;
 }
 
-bool compareTime(Time *time1, Time *time2)
+void publishRules(void)
 {
-  // Convert times to seconds since midnight
-  uint32_t sec1 = time1->hours * 3600 + time1->minutes * 60 + time1->seconds;
-  uint32_t sec2 = time2->hours * 3600 + time2->minutes * 60 + time2->seconds;
-  return (sec2 > sec1);
+  // Edited rules made current; the LM75B OS pin follows the lowest T threshold
+  alarmPublish();
+  // CRITICAL SECTION: program the LM75B threshold, whose OS pin requests a T sample on a crossing
+  xSemaphoreTake(xI2CMutex, portMAX_DELAY);
+  setTempThreshold(alarmLowest(CH_TEMP));
+  xSemaphoreGive(xI2CMutex);
+  // END OF CRITICAL SECTION
+}
+
+void flowControl(void)
+{
+  // Host can pause the export with XOFF and resume it with XON. Only these two bytes are consumed:
+  // anything else typed meanwhile goes to the pushback byte for the next command line.
+  if (pushback >= 0 || !pc.readable()) return;
+  int c = pc.getc();
+  if (c != XOFF) { pushback = c; return; }
+  
+  for (uint16_t waited = 0; waited < XOFF_TIMEOUT_MS; )
+  {
+    if (pushback < 0 && pc.readable()) // with the pushback full, later bytes wait in the UART FIFO
+    {
+      c = pc.getc();
+      if (c == XON) break;
+      if (c != XOFF) pushback = c;
+    }
+    else
+    {
+      vTaskDelay(pdMS_TO_TICKS(10)); // sleep instead of spinning on getc
+      waited += 10;
+    }
+  }
+}
+
+char* fmtStamp(char *buf, Tick stamp)
+{
+  // "hh:mm:ss.mmm", chained like the fmt.h formatters
+  uint16_t ms;
+  Time time = wallTime(stamp, &ms);
+  
+  buf = fmtStr(fmtTime(buf, time / 3600, time / 60 % 60, time % 60), ".");
+  *buf++ = '0' + ms / 100;
+  return fmtUint2(buf, ms % 100);
+}
+
+void printOutput(OutputData *output)
+{
+  // Built with fmt.h instead of printf("%.1f") to keep float printf out of the console task
+  char buf[80], *p;
+  
+  if (output->empty)
+  {
+    cputs("\nNo records to be read!\n");
+    return;
+  }
+  for (uint8_t c = 0; c < nts; c++)
+  {
+    p = fmtStr(buf, "\nTemperature ");
+    p = fmtStr(fmtUint(p, c), " (max, min, mean) = ");
+    p = fmtStr(fmtQ3(p, output->maxT[c]), ", ");
+    p = fmtStr(fmtQ3(p, output->minT[c]), ", ");
+    fmtQ3(p, output->meanT[c]);
+    cputs(buf);
+    p = fmtStr(buf, "\n  (stddev, p50, p90) = ");
+    p = fmtStr(fmtQ3(p, output->sdT[c]), ", ");
+    p = fmtStr(fmtQ3(p, output->p50T[c]), ", ");
+    fmtQ3(p, output->p90T[c]);
+    cputs(buf);
+  }
+  p = fmtStr(buf, "\nLuminosity (max, min, mean, stddev) = ");
+  p = fmtStr(fmtUint(p, output->maxL), ", ");
+  p = fmtStr(fmtUint(p, output->minL), ", ");
+  p = fmtStr(fmtTenths(p, output->meanL), ", ");
+  fmtStr(fmtTenths(p, output->sdL), "\n");
+  cputs(buf);
 }
@@ -0,0 +1,63 @@
+#include "fmt.h"
+
+char* fmtStr(char *buf, const char *str)
+{
+  while (*str != '\0')
+    *buf++ = *str++;
+  *buf = '\0';
+  return buf;
+}
+
+char* fmtUint(char *buf, uint32_t value)
+{
+  char tmp[FMT_UINT_LEN - 1];
+  uint8_t n = 0;
+  
+  // Digits are produced from the least significant one, then copied in order
+  do
+  {
+    tmp[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (n > 0)
+    *buf++ = tmp[--n];
+  *buf = '\0';
+  return buf;
+}
+
+char* fmtUint2(char *buf, uint8_t value)
+{
+  buf[0] = '0' + value / 10;
+  buf[1] = '0' + value % 10;
+  buf[2] = '\0';
+  return buf + 2;
+}
+
+char* fmtTime(char *buf, uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+  buf = fmtUint2(buf, hours);
+  *buf++ = ':';
+  buf = fmtUint2(buf, minutes);
+  *buf++ = ':';
+  return fmtUint2(buf, seconds);
+}
+
+char* fmtTenths(char *buf, int32_t tenths)
+{
+  if (tenths < 0)
+  {
+    *buf++ = '-';
+    tenths = -tenths;
+  }
+  buf = fmtUint(buf, tenths / 10);
+  *buf++ = '.';
+  *buf++ = '0' + tenths % 10;
+  *buf = '\0';
+  return buf;
+}
+
+char* fmtQ3(char *buf, int32_t q3)
+{
+  // Q3 (1/8) rounded to tenths, half away from zero
+  return fmtTenths(buf, (q3 * 10 + (q3 < 0 ? -4 : 4)) / 8);
+}
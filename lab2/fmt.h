@@ -0,0 +1,20 @@
+#include <cstdint>
+
+#ifndef FMT_H
+#define FMT_H
+
+// Small formatters used instead of printf on the LCD and console.
+// They write into a caller buffer, never allocate, and return a pointer
+// to the terminating '\0' so that calls can be chained.
+
+#define FMT_UINT_LEN 11 // "4294967295" + '\0'
+#define FMT_TIME_LEN 9  // "hh:mm:ss" + '\0'
+
+char* fmtStr(char *buf, const char *str);                         // copy of str
+char* fmtUint(char *buf, uint32_t value);                         // "123"
+char* fmtUint2(char *buf, uint8_t value);                         // "07" (0..99)
+char* fmtTime(char *buf, uint8_t hours, uint8_t minutes, uint8_t seconds); // "hh:mm:ss"
+char* fmtTenths(char *buf, int32_t tenths);                       // 123 -> "12.3"
+char* fmtQ3(char *buf, int32_t q3);                               // 189 (Q3) -> "23.6"
+
+#endif /* FMT_H */
@@ -5,68 +5,144 @@
 #include "LM75B.h"
 #include "C12832.h"
 #include "semphr.h"
+#include "timers.h"
 #include "shared.h" // custom header for shared objects
+#include "fmt.h"    // printf-free formatting
+#include "acq.h"    // interrupt-driven sensor acquisition
+#include "timebase.h" // monotonic 64-bit tick and wall clock offset
+#include "stats.h"    // fixed-point variance and percentiles
+#include "rollup.h"   // minute/hour buckets of the record history
+#include "agg.h"      // min/max/sum kernel over a column
+#include "store.h"    // record ring storage (structure of arrays)
+#include "alarm.h"    // threshold alarm rules
+#include "query.h"    // standing sliding-window queries
+#include "trend.h"    // EWMA and least-squares slope of T
+#include "wire.h"     // byte layout of records on the serial link
 
 // FUNCTIONS
 extern void monitor(void);
-bool isInvalid(Time *time);
-bool isInInterval(Record *record, Time *start);
-bool isInInterval(Record *record, Time *start, Time *end);
+Tick heldInInterval(Tick stamp, Tick next, Tick start, Tick end);
+void pushTelemetry(uint8_t type, const void *data);
+void alarmFire(char letter, uint8_t action, TickType_t wait);
+bool armClockAlarm(TickType_t wait);
+void setTempThreshold(Temp t);
+void setSensorPower(bool awake);
+void registerSensors(void);
+uint16_t tenths(uint64_t sum, uint64_t count);
+Temp meanTemp(int64_t sum, uint64_t count);
   
 BusOut leds(LED1,LED2,LED3,LED4);             // LEDs
 PwmOut r(p23), g(p24), b(p25), speaker(p26);  // RGB LED and buzzer
 C12832 lcd(p5, p7, p6, p8, p11);              // LCD
-LM75B sensor(p28, p27);                       // T sensor
+InterruptIn os(p21);                          // LM75B OS pins, wired-OR (over-temperature, active low)
 AnalogIn pot1(p19);                           // Potentiometer (L sensor)
 Serial pc(USBTX, USBRX);                      // Serial
 
 // TASKS
-TaskHandle_t xSensorTimer, xProcessingTimer;
+TaskHandle_t xSensorTimer, xProcessingTimer, xSensors;
+
+// TIMERS
+TimerHandle_t xClockAlarmTimer;   // one-shot, earliest clock alarm deadline
 
 // QUEUES
 QueueHandle_t xSensorInputQueue, xSensorOutputQueue, xProcessingInputQueue, xProcessingOutputQueue;
+QueueHandle_t xTelemetryQueue;
 
 // SEMAPHORES & MUTEXES
 SemaphoreHandle_t xAlarmSemaphore;
-SemaphoreHandle_t xClockMutex, xPrintingMutex, xAlarmMutex, xBufferMutex, xParamMutex;
+SemaphoreHandle_t xPrintingMutex, xSerialMutex, xAlarmMutex, xBufferMutex, xParamMutex, xI2CMutex;
 
 // SHARED DATA
-uint8_t hours = 0, minutes = 0, seconds = 0;
-uint8_t pmon = 3, tala = 5, pproc = 0; 
-uint8_t alah = 0, alam = 0, alas = 0;
-uint8_t alat = 20, alal = 2;
+uint32_t period[NCH] = {3000, 3000}; // sampling period per channel (ms, 0 deactivates)
+uint32_t misses[NCH] = {0, 0};    // missed sampling deadlines per channel
+uint8_t tala = 5, pproc = 0; 
+uint8_t alat = 20, alal = 2;      // thresholds of the first T and L alarm rules
 bool alaf = 0;                    // alaf = 0 --> a, alaf = 1 --> A
-uint8_t temp, lum;                // sensors' values
+bool oneshot = 0;                 // oneshot = 1 --> LM75B shut down between samples
+Temp hyst_t = 0;                  // change-driven logging: T hysteresis (any channel)
+uint8_t hyst_l = 0;               // change-driven logging: L hysteresis
+uint16_t heartbeat = 0;           // change-driven logging: longest silence in seconds (0 --> log every sample)
+bool sensor_awake = 1;            // LM75B power state (protected by xI2CMutex)
+LM75B *tsensors[NTS];             // registered T sensors (channel c is tsensors[c])
+uint8_t taddr[NTS];               // their I2C addresses
+uint8_t nts = 0;                  // number of registered T sensors
+Temp temp[NTS];                   // sensors' values
+uint8_t lum;
+uint16_t lum16;                   // luminosity at full (16-bit) resolution
+bool lum_filter = 0;              // lum_filter = 1 --> oversampled and filtered luminosity
 uint8_t tala_count = 0;           // counter for TaskAlarm
 uint8_t nr = 0, wi = 0, ri = 0;   // ring-buffer parameters (nr = valid records, wi = write index, ri = read index)
 uint8_t n_unread_indices = 0;     // difference between wi and ri
-Record records[NR];               // ring-buffer
-
-const Time invalid = {INVALID, INVALID, INVALID};
+uint32_t nw = 0;                  // total records written (sequence number of the next record)
+bool subscribed = 0;              // telemetry push mode
+uint16_t tlm_sent = 0, tlm_drops = 0; // telemetry frames queued/dropped because the host is too slow
+const char marks[] = "CTLR";      // alarm letters, drawn on the LCD at x = 77 + 10 * index
+uint8_t marks_pending = 0;        // marks alarmFire could not draw without waiting (bit = index), drawn by TaskClock
 
-// TIMERS (suspended if pmon/pproc are 0)
+// TIMERS (TaskProcessingTimer suspended if pproc is 0)
 void vTaskSensorTimer(void *pvParameters)
 {
-  TickType_t xLastWakeTime = xTaskGetTickCount(); // needed by vTaskDelayUntil()
-  Sender sender = TIMER;
-  uint8_t delay;
+  // Deadline scheduler for all sampling channels: sleeps until the earliest deadline
+  // (or until a period is changed, which notifies it) and samples every channel due
+  SensorRequest request = {TIMER, 0}, wakeup = {WAKEUP, 0};
+  uint32_t used[NCH] = {0};  // periods the deadlines were computed with (ms)
+  Tick next[NCH], deadline, now, late;
+  bool wake, woken = 0;
   
   for (;;) 
   {
+    now = tickNow();
+    request.channels = 0;
+    deadline = TICK_INVALID;
+    
     // CRITICAL SECTION
     xSemaphoreTake(xParamMutex, portMAX_DELAY);
-    delay = pmon;
+    wake = oneshot;
+    for (uint8_t c = 0; c < NCH; c++)
+    {
+      if (period[c] != used[c]) // new period: first sample one period from now
+      {
+        used[c] = period[c];
+        next[c] = now + pdMS_TO_TICKS(used[c]);
+      }
+      if (used[c] == 0) continue;
+      if (next[c] <= now)
+      {
+        request.channels |= 1 << c;
+        // Whole periods overslept are deadlines that were never sampled
+        late = (now - next[c]) / pdMS_TO_TICKS(used[c]);
+        misses[c] += late;
+        next[c] += (late + 1) * pdMS_TO_TICKS(used[c]);
+      }
+      if (next[c] < deadline) deadline = next[c];
+    }
+    // TaskSensors still busy with the previous request: these samples are lost
+    if (request.channels != 0 && xQueueSend(xSensorInputQueue, (void*)&request, 0) != pdPASS)
+      for (uint8_t c = 0; c < NCH; c++)
+        if (request.channels & (1 << c)) misses[c]++;
     xSemaphoreGive(xParamMutex);
     // END OF CRITICAL SECTION
-    xQueueSend(xSensorInputQueue, (void*)&sender, portMAX_DELAY); // unblock TaskSensors
-    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(1000 * delay));  // delay pmon sec
+    
+    if (request.channels & (1 << CH_TEMP)) woken = 0;
+    // One-shot: wake the LM75B one conversion time before the next T sample, so reading it adds no latency
+    if (wake && !woken && used[CH_TEMP] > LM75B_CONV_MS)
+    {
+      Tick at = next[CH_TEMP] - pdMS_TO_TICKS(LM75B_CONV_MS);
+      if (at <= now)
+        woken = xQueueSend(xSensorInputQueue, (void*)&wakeup, 0) == pdPASS;
+      else if (at < deadline)
+        deadline = at;
+    }
+    
+    // Sleep until the next deadline, cut short by a period change
+    ulTaskNotifyTake(pdTRUE, deadline == TICK_INVALID ? portMAX_DELAY : (TickType_t)(deadline - now));
   }
 }
 
 void vTaskProcessingTimer(void *pvParameters)
 {
   TickType_t xLastWakeTime = xTaskGetTickCount(); // needed by vTaskDelayUntil()
-  Interval interval = {invalid, invalid};
+  Interval interval = {TICK_INVALID, TICK_INVALID};
   Sender sender = TIMER;
   InputData input = {interval, sender};  
   uint8_t delay;
@@ -104,106 +180,182 @@ void vTaskAlarm(void *pvParameters)
   }
 }
 
-// CLOCK
+void osHandler(void)
+{
+  // Temperature crossed the LM75B threshold: sample T now and let the alarm rules decide
+  // (queue full: a sample is already pending)
+  SensorRequest request = {TIMER, 1 << CH_TEMP};
+  BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+  xQueueSendFromISR(xSensorInputQueue, &request, &xHigherPriorityTaskWoken);
+  portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+// CLOCK ALARM (one-shot timer callback, runs in the timer daemon task)
+void vClockAlarm(TimerHandle_t xTimer)
+{
+  uint8_t due;
+  bool active;
+  
+  // The daemon must never block (every timer would stall behind it): if TaskConsole holds the
+  // alarm mutex, try again on the next tick. Should the timer queue be full, it already holds
+  // the console's re-arm, which was computed before this deadline was consumed and covers it.
+  if (xSemaphoreTake(xAlarmMutex, 0) != pdPASS)
+  {
+    xTimerChangePeriod(xTimer, 1, 0);
+    return;
+  }
+  // CRITICAL SECTION
+  due = alarmClockDue(tickNow());
+  armClockAlarm(0); // next deadline (same reasoning if the queue is full)
+  active = alaf;
+  xSemaphoreGive(xAlarmMutex);
+  // END OF CRITICAL SECTION
+  if (due > 0 && active)
+    alarmFire('C', ALARM_ALL, 0); // LCD busy: the mark is left to TaskClock
+}
+
+// CLOCK (display only: the wall clock is derived from the tick count on demand, see timebase.h)
 void vTaskClock(void *pvParameters)
 {
-  TickType_t xLastWakeTime = xTaskGetTickCount(); // needed by vTaskDelayUntil()
+  char buf[FMT_TIME_LEN];
+  Time time;
+  uint16_t ms;
+  uint8_t pending;
   
   for (;;)
   {
-    /* CRITICAL SECTION: 
-    - hours, minutes, seconds may be under user modification from TaskConsole
-    - TaskSensor and TaskConsole may want to use the display
-    */
-    xSemaphoreTake(xClockMutex, portMAX_DELAY);
-    // Print clock and alarm mode
+    // Also keeps the 64-bit timebase extended when no sample is taken
+    time = wallTime(tickNow(), &ms);
+    // CRITICAL SECTION: TaskSensor and TaskConsole may want to use the display
     xSemaphoreTake(xPrintingMutex, portMAX_DELAY);
+    // Print clock and alarm mode
     lcd.locate(4,2);   // clock
-    lcd.printf("%02u:%02u:%02u", hours, minutes, seconds);
+    fmtTime(buf, time / 3600, time / 60 % 60, time % 60);
+    lcd.puts(buf);
     lcd.locate(117,2); // alarm mode
-    if (alaf)
-      lcd.printf("A");
-    else
-      lcd.printf("a");
-    xSemaphoreGive(xPrintingMutex);
-    
-    // CRITICAL SECTION
-    xSemaphoreTake(xAlarmMutex, portMAX_DELAY);
-    // Handle alarm
-    if (alaf)
-    {
-      if (alah != 0 || alam != 0 || alas != 0) // do nothing if clock threshold is 00:00:00
-      {
-        if (hours == alah && minutes == alam && seconds == alas)
-        {
-          // CRITICAL SECTION: TaskSensor and TaskConsole may want to use the display
-          xSemaphoreTake(xPrintingMutex, portMAX_DELAY);
-          lcd.locate(77, 2);
-          lcd.printf("C");
-          xSemaphoreGive(xPrintingMutex);
-          // Unblock TaskAlarm
-          tala_count = tala;
-          xSemaphoreGive(xAlarmSemaphore);
-        }
-      }
-    }
-    // END OF CRITICAL SECTION
-    xSemaphoreGive(xAlarmMutex);
-    // END CRITICAL SECTION
-    xSemaphoreGive(xClockMutex);
-
-    // 1 sec delay
-    vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(1000));
-
-    // CRITICAL SECTION: after the delay, hours, minutes and seconds may be again under modification
-    xSemaphoreTake(xClockMutex, portMAX_DELAY);
-    // Update time (after delay to start counting at 0 and have no issues with alarm)
-    if (seconds < 59) seconds++;
-    else
-    {
-      seconds = 0;
-      if (minutes < 59) minutes++;
-      else
+    lcd.putc(alaf ? 'A' : 'a');
+    // Alarm marks raised by the timer daemon while the display was taken
+    taskENTER_CRITICAL();
+    pending = marks_pending;
+    marks_pending = 0;
+    taskEXIT_CRITICAL();
+    for (uint8_t i = 0; pending != 0 && marks[i] != '\0'; i++)
+      if (pending & (1 << i))
       {
-        minutes = 0;
-        hours++;
+        lcd.locate(77 + 10 * i, 2);
+        lcd.putc(marks[i]);
       }
-    }
-    xSemaphoreGive(xClockMutex);
+    xSemaphoreGive(xPrintingMutex);
     // END OF CRITICAL SECTION
+    
+    // Redraw when the wall clock reaches the next second
+    vTaskDelay(pdMS_TO_TICKS(1000 - ms));
   }
 }
 
 // SENSORS
 void vTaskSensors(void *pvParameters)
 {
-  Sender sender;
+  SensorRequest request;
+  char buf[FMT_UINT_LEN + 4];
+  uint16_t adc;
+  uint8_t what;
+  bool shutdown, log;
+  Record logged = {0};       // last record saved
+  Temp dt;
+  uint8_t dl;
+  Tick now;
+  Temp ht;
+  uint8_t hl;
+  uint16_t hb;
+  uint8_t fired[ALARM_CHANNELS]; // alarm actions per channel
+  bool read;
   
   for (;;)
   {
     // Blocked until element is written in the queue
-    xQueueReceive(xSensorInputQueue, &sender, portMAX_DELAY);
+    xQueueReceive(xSensorInputQueue, &request, portMAX_DELAY);
     
-    // Read data
-    temp = (uint8_t)sensor.temp();
-    lum = pot1.read_u16() >> 14; // convert L to {0...3}
+    // CRITICAL SECTION
+    xSemaphoreTake(xParamMutex, portMAX_DELAY);
+    shutdown = oneshot;
+    ht = hyst_t; hl = hyst_l; hb = heartbeat;
+    xSemaphoreGive(xParamMutex);
+    // END OF CRITICAL SECTION
+    
+    if (request.sender == WAKEUP)
+    {
+      // CRITICAL SECTION: start the LM75B conversion, the sample follows LM75B_CONV_MS later
+      xSemaphoreTake(xI2CMutex, portMAX_DELAY);
+      setSensorPower(1);
+      xSemaphoreGive(xI2CMutex);
+      // END OF CRITICAL SECTION
+      continue;
+    }
+    
+    // Read data: I2C read and ADC conversion of the requested channels run together, the task sleeps until the ISRs notify
+    what = (request.channels & (1 << CH_TEMP) ? ACQ_TEMP : 0) | (request.channels & (1 << CH_LUM) ? ACQ_LUM : 0);
+    // CRITICAL SECTION: TaskConsole may be programming the sensor thresholds
+    xSemaphoreTake(xI2CMutex, portMAX_DELAY);
+    if ((what & ACQ_TEMP) && !sensor_awake)
+    {
+      // Not woken in advance (console read, or T period too short): wait for one conversion
+      setSensorPower(1);
+      vTaskDelay(pdMS_TO_TICKS(LM75B_CONV_MS));
+    }
+    acqStart(what);
+    read = acqWait(temp, &adc);
+    if (read && (what & ACQ_LUM)) // LM75B readings are already Temp (Q3)
+    {
+      lum16 = adc;
+      lum = adc >> 14;                // convert L to {0...3}
+    }
+    // else: keep the previous values (channel not due, bus error or timeout)
+    // One-shot: sleep until the next WAKEUP. Not while a T alarm is armed: a sleeping LM75B stops
+    // converting and its OS pin could not raise the alarm between samples
+    if (shutdown && (what & ACQ_TEMP) && !(alaf && alarmArmed(CH_TEMP)))
+      setSensorPower(0);
+    xSemaphoreGive(xI2CMutex);
+    // END OF CRITICAL SECTION
+    
+    // Change-driven logging: a sample within the hysteresis of the last record is not saved,
+    // unless the last record is older than the heartbeat (pr weights each record until the next one)
+    now = tickNow();
+    if (read && (what & ACQ_TEMP))
+      trendAdd(now, temp, nts); // every sample, logged or not
+    log = hb == 0 || now - logged.stamp >= (Tick)hb * configTICK_RATE_HZ;
+    dl = lum > logged.luminosity ? lum - logged.luminosity : logged.luminosity - lum;
+    if (dl > hl) log = 1;
+    for (uint8_t c = 0; c < nts; c++)
+    {
+      dt = temp[c] > logged.temperature[c] ? temp[c] - logged.temperature[c] : logged.temperature[c] - temp[c];
+      if (dt > ht) log = 1;
+    }
     
     // CRITICAL SECTION
     xSemaphoreTake(xBufferMutex, portMAX_DELAY);
-    // Save record
-    records[wi].hours = hours;
-    records[wi].minutes = minutes;
-    records[wi].seconds = seconds;
-    records[wi].temperature = temp;
-    records[wi].luminosity = lum;
-    // Increment index
-    if (nr < NR) nr++;
-    wi = (wi + 1) % NR;
-    n_unread_indices++;                              // increment difference between wi and ri
-    if (n_unread_indices == NR)                      // if wi finishes the ring and goes over ri
+    if (log || nr == 0) // (records deleted: start again from this sample)
     {
-      ri = (ri + 1 + (n_unread_indices - NR)) % NR;  // increment ri
-      n_unread_indices = NR - 1;                     // decrement difference
+      // The previous record held its values until now
+      if (nr > 0)
+        rollupHold(&logged, logged.stamp, now);
+      // Save record (stamped from the tick count, no clock lock and no torn hh:mm:ss)
+      logged.stamp = now;
+      memcpy(logged.temperature, temp, sizeof(temp));
+      logged.luminosity = lum;
+      storeWrite(wi, &logged);
+      queryAppend(&logged);
+      // Increment index
+      if (nr < NR) nr++;
+      wi = (wi + 1) % NR;
+      nw++;
+      n_unread_indices++;                              // increment difference between wi and ri
+      if (n_unread_indices == NR)                      // if wi finishes the ring and goes over ri
+      {
+        ri = (ri + 1 + (n_unread_indices - NR)) % NR;  // increment ri
+        n_unread_indices = NR - 1;                     // decrement difference
+      }
+      pushTelemetry(TLM_RECORD, &logged); // record just saved
     }
     xSemaphoreGive(xBufferMutex);
     // END OF CRITICAL SECTION
@@ -211,50 +363,32 @@ void vTaskSensors(void *pvParameters)
     // CRITICAL SECTION
     xSemaphoreTake(xPrintingMutex, portMAX_DELAY);
     // Print sensors' values
-    lcd.locate(4,20);    // temperature
-    lcd.printf("%u C ", temp); 
+    lcd.locate(4,20);    // temperature (channel 0)
+    fmtStr(fmtQ3(buf, temp[0]), " C ");
+    lcd.puts(buf);
     lcd.locate(107, 20); // luminosity
-    lcd.printf("L %u", lum);
+    fmtUint(fmtStr(buf, "L "), lum);
+    lcd.puts(buf);
     xSemaphoreGive(xPrintingMutex);
     
-    if (sender == CONSOLE)
+    if (request.sender == CONSOLE)
     {
       // Send data to user
-      Sensor values = {temp, lum};
+      Sensor values;
+      memcpy(values.temp, temp, sizeof(temp));
+      values.lum = lum;
+      values.lum16 = lum16;
       xQueueSend(xSensorOutputQueue, (void*)&values, portMAX_DELAY);
     }
 
-    // CRITICAL SECTION
-    xSemaphoreTake(xAlarmMutex, portMAX_DELAY);
-    // Handle alarm
+    // Handle alarms: one pass over the rules of the sampled channels, no mutex (see alarm.h)
+    alarmEvaluate(temp, nts, lum, trendRate(), request.channels, fired);
     if (alaf)
     {
-      if (temp >= alat)
-      {
-        // CRITICAL SECTION
-        xSemaphoreTake(xPrintingMutex, portMAX_DELAY);
-        lcd.locate(87,2);
-        lcd.printf("T");
-        xSemaphoreGive(xPrintingMutex);
-        // Unblock TaskAlarm
-        tala_count = tala;
-        xSemaphoreGive(xAlarmSemaphore);
-      }
-      
-      if (lum >= alal)
-      {
-        // CRITICAL SECTION
-        xSemaphoreTake(xPrintingMutex, portMAX_DELAY);
-        lcd.locate(97,2);
-        lcd.printf("L");
-        xSemaphoreGive(xPrintingMutex);
-        // Unblock TaskAlarm
-        tala_count = tala;
-        xSemaphoreGive(xAlarmSemaphore);
-      }
+      if (fired[CH_TEMP]) alarmFire('T', fired[CH_TEMP], portMAX_DELAY);
+      if (fired[CH_LUM]) alarmFire('L', fired[CH_LUM], portMAX_DELAY);
+      if (fired[ALARM_RATE]) alarmFire('R', fired[ALARM_RATE], portMAX_DELAY);
     }
-    xSemaphoreGive(xAlarmMutex);
-    // END OF CRITICAL SECTION
   }
 }
 
@@ -262,18 +396,29 @@ void vTaskSensors(void *pvParameters)
 void vTaskProcessing(void *pvParameters)
 {
   InputData input;
-  uint8_t temp, lum;
-  uint8_t count, new_temp, new_lum, sum_lum;
-  int sum_temp; // 8 bits are not enough
-  uint8_t maxT, minT, maxL, minL;
-  float meanT, meanL;
+  Temp temp;
+  uint8_t lum;
+  AggT aggTemp[NTS];  // per channel
+  AggL aggLum;
+  Record record;
+  // Columns read from the store, compacted to the samples held inside the interval for the kernel
+  // (index 0 carries the last record of the previous chunk, whose hold ends in this one)
+  Tick colS[AGG_CHUNK + 1];
+  Temp colT[NTS][AGG_CHUNK + 1];
+  uint8_t colL[AGG_CHUNK + 1];
+  uint32_t colW[AGG_CHUNK + 1];
+  uint8_t n, m, h, k;
+  Bucket bucket;
+  Welford welT[NTS], welL;
+  static Sketch sketch[NTS]; // 2 KB, kept off the task stack
+  Tick start, end, now, weight, cut, oldest;
+  uint32_t seq, last;
+  bool more;
   
   for (;;)
   {
     // Blocked until element is written in the queue
     xQueueReceive(xProcessingInputQueue, &input, portMAX_DELAY);
-    // Initialize variables
-    count = 0; sum_temp = 0; sum_lum = 0; maxT = 0; minT = 50; maxL = 0; minL = 4;
     
     switch (input.sender)
     {
@@ -284,8 +429,9 @@ void vTaskProcessing(void *pvParameters)
         if (nr != NR && n_unread_indices == 0) {} // don't read if there are no elements
         else
         {
-          temp = records[ri].temperature;
-          lum = records[ri].luminosity;
+          storeRead(ri, &record);
+          temp = record.temperature[0]; // RGB follows channel 0
+          lum = record.luminosity;
           // Increment index
           ri = (ri + 1) % NR;       
           if (n_unread_indices != 0) // if ri was behind wi, reduce distance
@@ -296,8 +442,11 @@ void vTaskProcessing(void *pvParameters)
         
         // mutex not used because only r,b,leds only used here
         // RGB
-        r = 1 - temp / 50.0; // temp = 50 -> r = 1, b = 0 (g = 0 always)
-        b = temp / 50.0;
+        // temp = 50 -> r = 1, b = 0 (g = 0 always), integer pulse widths instead of float duty cycles
+        if (temp < 0) temp = 0;
+        if (temp > TEMP_C(50)) temp = TEMP_C(50);
+        b.pulsewidth_us(PWM_PERIOD_US * temp / TEMP_C(50));
+        r.pulsewidth_us(PWM_PERIOD_US - PWM_PERIOD_US * temp / TEMP_C(50));
         // LEDs
         switch(lum)
         {
@@ -316,98 +465,155 @@ void vTaskProcessing(void *pvParameters)
         }
         break;
         
+      case WAKEUP: // only sent to TaskSensors
+        break;
+        
       case CONSOLE:
-        Time time1 = input.interval.time1;
-        Time time2 = input.interval.time2;
+        // Each record holds its values until the next one is saved (change-driven logging skips
+        // unchanged samples), so means are weighted by how long each value was held in [start, end]
+        now = tickNow();
+        start = input.interval.start == TICK_INVALID ? 0 : input.interval.start;
+        end = input.interval.end == TICK_INVALID ? now : input.interval.end;
+        for (uint8_t c = 0; c < nts; c++) { welfordInit(&welT[c]); sketchInit(&sketch[c]); }
+        welfordInit(&welL);
+        // CRITICAL SECTION
+        xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+        seq = nw - nr; // oldest record
+        last = nw;
+        // Older than the oldest record: whole rollup buckets up to the first minute edge the records cover
+        cut = start;
+        if (nr > 0 && start < (oldest = storeStamp((wi + NR - nr) % NR)))
+        {
+          cut = (oldest + MINUTE_TICKS - 1) / MINUTE_TICKS * MINUTE_TICKS;
+          if (cut > rollupClosed()) cut = rollupClosed();
+          if (cut < start) cut = start;
+        }
+        xSemaphoreGive(xBufferMutex);
+        // END OF CRITICAL SECTION
         
-        // Process totality of records
-        if (isInvalid(&time1) && isInvalid(&time2))
+        for (uint8_t c = 0; c < nts; c++) aggInit(&aggTemp[c]);
+        aggInit(&aggLum);
+        
+        // Rollup buckets in [start, cut), each one as its mean held for the ticks it covers
+        for (uint8_t i = 0; i < ROLLUP_BUCKETS && cut > start; i++)
         {
-          for (uint8_t i = 0; i < nr; i++) // read valid records (not an issue if not ordered)
+          // CRITICAL SECTION
+          xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+          more = rollupBucket(i, start, cut < end + 1 ? cut : end + 1, &bucket);
+          xSemaphoreGive(xBufferMutex);
+          // END OF CRITICAL SECTION
+          if (!more) continue;
+          for (uint8_t c = 0; c < nts; c++)
           {
-            // CRITICAL SECTION
-            xSemaphoreTake(xBufferMutex, portMAX_DELAY);
-            new_temp = records[i].temperature;
-            new_lum = records[i].luminosity;
-            xSemaphoreGive(xBufferMutex);
-            // END OF CRITICAL SECTION
-            // T
-            if (new_temp > maxT) maxT = new_temp; // max
-            if (new_temp < minT) minT = new_temp; // min
-            sum_temp += new_temp;
-            // L
-            if (new_lum > maxL) maxL = new_lum;   // max
-            if (new_lum < minL) minL = new_lum;   // min
-            sum_lum += new_lum;
+            aggMerge(&aggTemp[c], bucket.minT[c], bucket.maxT[c], (int64_t)bucket.meanT[c] * bucket.weight, bucket.weight);
+            welfordAdd(&welT[c], bucket.meanT[c], bucket.weight); // spread inside a bucket is not kept
+            sketchAdd(&sketch[c], bucket.meanT[c], bucket.weight);
           }
-          meanT = sum_temp / float(nr);           // mean
-          meanL = sum_lum / float(nr);
+          aggMerge(&aggLum, bucket.minL, bucket.maxL, ((uint64_t)bucket.meanL * bucket.weight + 5) / 10, bucket.weight);
+          welfordAdd(&welL, bucket.meanL, bucket.weight); // tenths
         }
-        // Process from t1 to end
-        else if (isInvalid(&time2))
+        
+        // Records from cut on, in order and one chunk per buffer lock. A record's weight is
+        // known once the next stamp is, so the last one of a chunk is held for the next chunk.
+        for (h = 0; ; )
         {
-          for (uint8_t i = 0; i < nr; i++) // read valid records
+          // CRITICAL SECTION
+          xSemaphoreTake(xBufferMutex, portMAX_DELAY);
+          if (nw - seq > nr) { seq = nw - nr; h = 0; } // overwritten meanwhile: restart from the oldest
+          if (seq > last) seq = last;                  // all of them up to last: nothing left to read
+          n = last - seq < AGG_CHUNK ? last - seq : AGG_CHUNK;
+          storeColumns((wi + NR - (nw - seq)) % NR, n, colS + h, &colT[0][h], AGG_CHUNK + 1, nts, colL + h);
+          xSemaphoreGive(xBufferMutex);
+          // END OF CRITICAL SECTION
+          seq += n;
+          n += h;
+          
+          // Keep the samples held inside [cut, end], with their weight (compacting never overtakes k)
+          for (k = 0, m = 0; k < n; k++)
           {
-            // CRITICAL SECTION
-            xSemaphoreTake(xBufferMutex, portMAX_DELAY);
-            if (isInInterval(&records[i], &time1)) // save only records in interval
-            {
-              count++;                                   // count records in interval
-
-              new_temp = records[i].temperature;
-              new_lum = records[i].luminosity;
-              // T
-              if (new_temp > maxT) maxT = new_temp; // max
-              if (new_temp < minT) minT = new_temp; // min
-              sum_temp += new_temp;
-              // L
-              if (new_lum > maxL) maxL = new_lum;   // max
-              if (new_lum < minL) minL = new_lum;   // min
-              sum_lum += new_lum;
-            }
-            xSemaphoreGive(xBufferMutex);
-            // END OF CRITICAL SECTION
+            if (k + 1 == n && seq != last) break; // its hold ends in the next chunk
+            weight = heldInInterval(colS[k], k + 1 < n ? colS[k + 1] : now + 1, cut, end); // newest: held until now
+            if (weight == 0) continue;
+            for (uint8_t c = 0; c < nts; c++) colT[c][m] = colT[c][k];
+            colL[m] = colL[k];
+            colW[m++] = weight > UINT32_MAX ? UINT32_MAX : weight;
           }
-          meanT = sum_temp / float(count);          // mean
-          meanL = sum_lum / float(count);
-        }
-        // Process from t1 to t2
-        else
-        {
-          for (uint8_t i = 0; i < nr; i++) // read valid records
+          
+          // One kernel call per column, then the summaries that need every sample
+          for (uint8_t c = 0; c < nts; c++)
           {
-            // CRITICAL SECTION
-            xSemaphoreTake(xBufferMutex, portMAX_DELAY);
-            if (isInInterval(&records[i], &time1, &time2))  // save only records in interval
+            aggT(&aggTemp[c], colT[c], colW, m);
+            for (k = 0; k < m; k++)
             {
-              count++;                              // count records in interval
-
-              new_temp = records[i].temperature;
-              new_lum = records[i].luminosity;
-              // T
-              if (new_temp > maxT) maxT = new_temp; // max
-              if (new_temp < minT) minT = new_temp; // min
-              sum_temp += new_temp;
-              // L
-              if (new_lum > maxL) maxL = new_lum;   // max
-              if (new_lum < minL) minL = new_lum;   // min
-              sum_lum += new_lum;
+              welfordAdd(&welT[c], colT[c][k], colW[k]);
+              sketchAdd(&sketch[c], colT[c][k], colW[k]);
             }
-            xSemaphoreGive(xBufferMutex);
-            // END OF CRITICAL SECTION
           }
-          meanT = sum_temp / float(count);          // mean
-          meanL = sum_lum / float(count);
+          aggL(&aggLum, colL, colW, m);
+          for (k = 0; k < m; k++)
+            welfordAdd(&welL, colL[k] * 10, colW[k]); // tenths
+          if (seq == last) break;
+          
+          // The last record moves to index 0 for the next chunk
+          colS[0] = colS[n - 1];
+          for (uint8_t c = 0; c < nts; c++) colT[c][0] = colT[c][n - 1];
+          colL[0] = colL[n - 1];
+          h = 1;
         }
         
         // Send data to user
-        OutputData output = {maxT, minT, meanT, maxL, minL, meanL};
+        OutputData output;
+        for (uint8_t c = 0; c < nts; c++)
+        {
+          output.maxT[c] = aggTemp[c].max;
+          output.minT[c] = aggTemp[c].min;
+          output.meanT[c] = meanTemp(aggTemp[c].sum, aggTemp[c].weight); // mean
+          output.sdT[c] = welfordStddev(&welT[c]);
+          output.p50T[c] = sketchQuantile(&sketch[c], 50);
+          output.p90T[c] = sketchQuantile(&sketch[c], 90);
+        }
+        output.empty = aggLum.empty; // every channel sees the same records
+        output.maxL = aggLum.max;
+        output.minL = aggLum.min;
+        output.meanL = tenths(aggLum.sum, aggLum.weight);
+        output.sdL = welfordStddev(&welL);
         xQueueSend(xProcessingOutputQueue, (void*)&output, portMAX_DELAY);
         break;
     }
   }
 }
 
+// TELEMETRY
+void vTaskTelemetry(void *pvParameters)
+{
+  Telemetry frame;
+  uint8_t seq = 0, checksum;
+  
+  for (;;)
+  {
+    // Blocked until a record or an alarm is pushed
+    xQueueReceive(xTelemetryQueue, &frame, portMAX_DELAY);
+    
+    // CRITICAL SECTION: a frame is never split by console output (each console write takes the mutex)
+    xSemaphoreTake(xSerialMutex, portMAX_DELAY);
+    // Frame: SOF, type, sequence number, length, data, XOR of type, sequence, length and data
+    pc.putc(SOF);
+    pc.putc(frame.type);
+    pc.putc(seq);
+    pc.putc(frame.len);
+    checksum = frame.type ^ seq ^ frame.len;
+    for (uint8_t i = 0; i < frame.len; i++)
+    {
+      pc.putc(frame.data[i]);
+      checksum ^= frame.data[i];
+    }
+    pc.putc(checksum);
+    xSemaphoreGive(xSerialMutex);
+    // END OF CRITICAL SECTION
+    seq++; // lets the host detect dropped frames
+  }
+}
+
 // CONSOLE
 void vTaskConsole(void *pvParameters)
 {
@@ -424,26 +630,32 @@ int main(void) {
 
   // --- APPLICATION TASKS CAN BE CREATED HERE ---
 
+  r.period_us(PWM_PERIOD_US);
   r = 1; g = 1; b = 1; // RGB off                   
 
   // Semaphores and mutexes
   xAlarmSemaphore = xSemaphoreCreateBinary();   // used to unblock Alarm  
-  xClockMutex = xSemaphoreCreateMutex();        // used for hours, minutes, seconds
   xBufferMutex = xSemaphoreCreateMutex();       // used for 
   xPrintingMutex = xSemaphoreCreateMutex();     // used for lcd
-  xAlarmMutex = xSemaphoreCreateMutex();        // used for alah, alam, alas, alat, alal, alaf
-  xParamMutex = xSemaphoreCreateMutex();        // used for pmon, tala, pproc
+  xSerialMutex = xSemaphoreCreateMutex();       // used for serial port (one console write or telemetry frame at a time)
+  xAlarmMutex = xSemaphoreCreateMutex();        // used for the clock alarms, alat, alal, alaf (not by the alarm rules, see alarm.h)
+  xParamMutex = xSemaphoreCreateMutex();        // used for period, misses, tala, pproc
+  xI2CMutex = xSemaphoreCreateMutex();          // used for the LM75B (acquisition and configuration)
 
   // Queues
-  xSensorInputQueue = xQueueCreate(1, sizeof(Sender));
+  xSensorInputQueue = xQueueCreate(2, sizeof(SensorRequest)); // a WAKEUP may follow a sample
   xSensorOutputQueue = xQueueCreate(1, sizeof(Sensor));
   xProcessingInputQueue = xQueueCreate(1, sizeof(InputData));
   xProcessingOutputQueue = xQueueCreate(1, sizeof(OutputData));
+  xTelemetryQueue = xQueueCreate(TLM_QUEUE, sizeof(Telemetry));
+  
+  // Timers (period set when armed)
+  xClockAlarmTimer = xTimerCreate("ClockAlarm", 1, pdFALSE, NULL, vClockAlarm);
   
   // Check if sufficient heap space
-  if (xAlarmSemaphore == NULL || xClockMutex == NULL || xPrintingMutex == NULL || xBufferMutex == NULL || xAlarmMutex == NULL
-      || xParamMutex == NULL || xSensorInputQueue == NULL || xSensorInputQueue == NULL || xProcessingInputQueue == NULL 
-      || xProcessingOutputQueue == NULL)
+  if (xAlarmSemaphore == NULL || xPrintingMutex == NULL || xSerialMutex == NULL || xBufferMutex == NULL || xAlarmMutex == NULL
+      || xParamMutex == NULL || xI2CMutex == NULL || xSensorInputQueue == NULL || xSensorInputQueue == NULL || xProcessingInputQueue == NULL 
+      || xProcessingOutputQueue == NULL || xTelemetryQueue == NULL || xClockAlarmTimer == NULL)
   {
     printf("\nInsufficient heap space! Exiting...\n");
     return 1;
@@ -454,10 +666,30 @@ int main(void) {
   xTaskCreate(vTaskSensorTimer, "TimerPMON", 2*configMINIMAL_STACK_SIZE, NULL, 4, &xSensorTimer);
   xTaskCreate(vTaskProcessingTimer, "TimerPPROC", 2*configMINIMAL_STACK_SIZE, NULL, 5, &xProcessingTimer);
   xTaskCreate(vTaskClock, "Clock", 2*configMINIMAL_STACK_SIZE, NULL, 3, NULL);
-  xTaskCreate(vTaskSensors, "Sensors", 2*configMINIMAL_STACK_SIZE, NULL, 3, NULL);
-  xTaskCreate(vTaskProcessing, "Processing", 2*configMINIMAL_STACK_SIZE, NULL, 2, NULL);
+  xTaskCreate(vTaskSensors, "Sensors", 2*configMINIMAL_STACK_SIZE, NULL, 3, &xSensors);
+  xTaskCreate(vTaskProcessing, "Processing", 4*configMINIMAL_STACK_SIZE, NULL, 2, NULL); // record chunk, columns and summaries
+  xTaskCreate(vTaskTelemetry, "Telemetry", 2*configMINIMAL_STACK_SIZE, NULL, 2, NULL); // above Console, which busy-waits on getc
   xTaskCreate(vTaskConsole, "Console", 2*configMINIMAL_STACK_SIZE, NULL, 1, NULL);
   
+  // Probe the I2C bus for LM75B sensors
+  registerSensors();
+  
+  // LM75B OS pins in comparator mode (2 consecutive faults) raise the temperature alarm
+  for (uint8_t c = 0; c < nts; c++)
+  {
+    tsensors[c]->osMode(LM75B::OS_COMPARATOR);
+    tsensors[c]->osPolarity(LM75B::OS_ACTIVE_LOW);
+    tsensors[c]->osFaultQueue(LM75B::OS_FAULT_QUEUE_2);
+  }
+  alarmInit(TEMP_C(alat), alal);
+  setTempThreshold(alarmLowest(CH_TEMP));
+  os.mode(PullUp);
+  os.fall(osHandler);
+  NVIC_SetPriority(EINT3_IRQn, 12); // GPIO interrupts must be allowed to call FreeRTOS FromISR functions
+  
+  // Sensor interrupts notify TaskSensors. The polled reads in setTempThreshold() left the LM75B pointers on the temperature register.
+  acqInit(xSensors, taddr, nts);
+  
   // Suspend TaskProcessingTimer because pproc is 0 by default. Task will be resumed when user modifies pproc.
   vTaskSuspend(xProcessingTimer);
   
@@ -471,42 +703,135 @@ int main(void) {
 
 // ---- UTILITY ----
 
-bool isInvalid(Time *time)
+void pushTelemetry(uint8_t type, const void *data)
 {
-  if (time->hours == invalid.hours) // && time->minutes == invalid.minutes && time->seconds == invalid.seconds)
-    return true;
-  return false;
+  if (!subscribed) return;
+  
+  Telemetry frame;
+  frame.type = type;
+  if (type == TLM_RECORD)
+    frame.len = wireRecord(frame.data, (const Record*)data, nts); // wire.h layout, nts channels
+  else
+  {
+    frame.data[0] = *(const uint8_t*)data;
+    frame.len = 1;
+  }
+  // Never block the producer: if the host can't keep up the frame is dropped and counted
+  BaseType_t sent = xQueueSend(xTelemetryQueue, (void*)&frame, 0);
+  // CRITICAL SECTION: counters are shared by all producers
+  taskENTER_CRITICAL();
+  if (sent == pdPASS) tlm_sent++;
+  else tlm_drops++;
+  taskEXIT_CRITICAL();
+  // END OF CRITICAL SECTION
 }
 
-bool isInInterval(Record *record, Time *start) 
+void alarmFire(char letter, uint8_t action, TickType_t wait)
 {
-  uint8_t r_hh = record->hours, r_mm = record->minutes, r_ss = record->seconds;                         // record
-  uint8_t s_hh = uint8_t(start->hours), s_mm = uint8_t(start->minutes), s_ss = uint8_t(start->seconds); // start
-  
-  // record >= time1
-  if (r_hh > s_hh ||                                
-      r_hh == s_hh && r_mm > s_mm ||
-      r_hh == s_hh && r_mm == s_mm && r_ss >= s_ss) 
-    return true;
-  return false;
+  // Actions of a raised alarm ('C', 'T', 'L' or 'R'). Telemetry and buzzer never block; the timer
+  // daemon passes wait = 0 for the display, and a mark it can't draw at once is drawn by TaskClock.
+  uint8_t i = strchr(marks, letter) - marks;
+  if (action & ALARM_LCD)
+  {
+    // CRITICAL SECTION: TaskSensor and TaskConsole may want to use the display
+    if (xSemaphoreTake(xPrintingMutex, wait) == pdPASS)
+    {
+      lcd.locate(77 + 10 * i, 2);
+      lcd.putc(letter);
+      xSemaphoreGive(xPrintingMutex);
+    }
+    else
+    {
+      taskENTER_CRITICAL();
+      marks_pending |= 1 << i;
+      taskEXIT_CRITICAL();
+    }
+    // END OF CRITICAL SECTION
+  }
+  if (action & ALARM_TLM)
+    pushTelemetry(TLM_ALARM, &letter);
+  if (action & ALARM_BUZZER)
+  {
+    // Unblock TaskAlarm
+    tala_count = tala;
+    xSemaphoreGive(xAlarmSemaphore);
+  }
 }
 
-bool isInInterval(Record *record, Time *start, Time *end)
+bool armClockAlarm(TickType_t wait)
 {
-  uint8_t r_hh = record->hours, r_mm = record->minutes, r_ss = record->seconds;                         // record
-  uint8_t s_hh = uint8_t(start->hours), s_mm = uint8_t(start->minutes), s_ss = uint8_t(start->seconds); // start
-  uint8_t e_hh = uint8_t(end->hours), e_mm = uint8_t(end->minutes), e_ss = uint8_t(end->seconds);       // end
-  
-  // record >= time1
-  if (r_hh > s_hh ||                                
-      r_hh == s_hh && r_mm > s_mm ||
-      r_hh == s_hh && r_mm == s_mm && r_ss >= s_ss) 
+  // Caller holds xAlarmMutex. The timer daemon passes wait = 0: it can't wait on its own command queue.
+  // Returns 0 if the command could not be queued within wait (the timer keeps its previous deadline).
+  Tick next = alarmClockNext(), now = tickNow();
+  if (next == TICK_INVALID)
+    return xTimerStop(xClockAlarmTimer, wait) == pdPASS;
+  return xTimerChangePeriod(xClockAlarmTimer, next > now ? (TickType_t)(next - now) : 1, wait) == pdPASS; // also starts it
+}
+
+void setTempThreshold(Temp t)
+{
+  // t: lowest threshold of the T rules (Q3), so every T rule gets the early sample; TEMP_MAX (no T
+  // rule) parks OS at the top of the range. OS asserts when T > TOS (0.5 °C steps): TOS = t - 0.5
+  // gives the same T >= t as the polled check. It is released below THYST, 1 °C lower, so a noisy
+  // reading does not retrigger the alarm.
+  float tos = t > TEMP_C(125) ? 125 : (float)t / (1 << TEMP_Q) - 0.5f;
+  for (uint8_t c = 0; c < nts; c++)
+  {
+    tsensors[c]->alertTemp(tos);
+    tsensors[c]->alertHyst(tos - 1);
+    // Point the LM75B back to the temperature register for the interrupt-driven reads
+    tsensors[c]->temp_raw();
+  }
+}
+
+void setSensorPower(bool awake)
+{
+  // Caller holds xI2CMutex
+  if (awake == sensor_awake) return;
+  for (uint8_t c = 0; c < nts; c++)
   {
-    // record <= time2
-    if (r_hh < e_hh ||
-        r_hh == e_hh && r_mm < e_mm ||
-        r_hh == e_hh && r_mm == e_mm && r_ss <= e_ss)
-      return true; 
+    tsensors[c]->powerMode(awake ? LM75B::POWER_NORMAL : LM75B::POWER_SHUTDOWN);
+    // Point the LM75B back to the temperature register for the interrupt-driven reads
+    tsensors[c]->temp_raw();
+  }
+  sensor_awake = awake;
+}
+
+void registerSensors(void)
+{
+  // Every address that answers becomes the next T channel
+  for (uint8_t a = 0; a < NTS; a++)
+  {
+    LM75B::Address address = (LM75B::Address)(LM75B::ADDRESS_0 + (a << 1));
+    LM75B *s = new LM75B(p28, p27, address);
+    if (s->open())
+    {
+      taddr[nts] = address;
+      tsensors[nts++] = s;
+    }
+    else delete s;
   }
-  return false;
+}
+
+uint16_t tenths(uint64_t sum, uint64_t count)
+{
+  // Rounded mean in tenths, without float division
+  if (count == 0) return 0;
+  return (sum * 10 + count / 2) / count;
+}
+
+Temp meanTemp(int64_t sum, uint64_t count)
+{
+  // Rounded (half away from zero) mean of Q3 samples, still Q3
+  if (count == 0) return 0;
+  return (sum + (sum < 0 ? -(int64_t)(count / 2) : (int64_t)(count / 2))) / (int64_t)count;
+}
+
+Tick heldInInterval(Tick stamp, Tick next, Tick start, Tick end)
+{
+  // Ticks of [stamp, next) inside [start, end]; a record in the interval always weighs at least 1
+  Tick from = stamp > start ? stamp : start;
+  Tick to = next < end + 1 ? next : end + 1;
+  if (to > from) return to - from;
+  return stamp >= start && stamp <= end;
 }
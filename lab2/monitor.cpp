@@ -2,32 +2,52 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdarg.h>
 #include "mbed.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
 #include "shared.h" // custom header for shared objects
 
 extern Serial pc;;
+extern SemaphoreHandle_t xSerialMutex;
+extern int pushback;
 
 /*-------------------------------------------------------------------------+
 | Headers of command functions
 +--------------------------------------------------------------------------*/ 
+       void cprintf (const char*, ...);
+       void cputs (const char*);
        void cmd_sos (int, char**);
+       void cmd_hi (int, char**);
 extern void cmd_send (int, char**);
 extern void cmd_rc (int, char**);
 extern void cmd_sc (int, char**);
 extern void cmd_rtl (int, char**);
+extern void cmd_rtr (int, char**);
 extern void cmd_rp (int, char**);
 extern void cmd_mmp (int, char**);
 extern void cmd_mta (int, char**);
 extern void cmd_mpp (int, char**);
+extern void cmd_msp (int, char**);
+extern void cmd_rdm (int, char**);
+extern void cmd_mpm (int, char**);
+extern void cmd_mlf (int, char**);
+extern void cmd_mcd (int, char**);
 extern void cmd_rai (int, char**);
 extern void cmd_dac (int, char**);
 extern void cmd_dtl (int, char**);
+extern void cmd_dar (int, char**);
+extern void cmd_dra (int, char**);
 extern void cmd_aa (int, char**);
 extern void cmd_cai (int, char**);
 extern void cmd_ir (int, char**);
 extern void cmd_lr (int, char**);
+extern void cmd_er (int, char**);
 extern void cmd_dr (int, char**);
 extern void cmd_pr (int, char**);
+extern void cmd_dq (int, char**);
+extern void cmd_rq (int, char**);
+extern void cmd_st (int, char**);
 
 /*-------------------------------------------------------------------------+
 | Variable and constants definition
@@ -42,27 +62,50 @@ struct  command_d {
   char* cmd_help;
 } const commands[] = {
   {cmd_sos, "sos", "                          - display commands"},
+  {cmd_hi,  "hi",  "                           - command history (!! repeats last line, !n the n-th last)"},
   {cmd_rc,  "rc",  "                           - read clock"},
   {cmd_sc,  "sc",  " hh:mm:ss                  - set clock"},
   {cmd_rtl, "rtl", "                          - read temperature and luminosity"},
-  {cmd_rp,  "rp",  "                           - read parameters (pmon, tala, pproc)"},
-  {cmd_mmp, "mmp", "p                         - modify monitoring period (seconds - 0 deactivate)"},
+  {cmd_rtr, "rtr", "                          - read temperature trend (EWMA, slope in °C/min per channel)"},
+  {cmd_rp,  "rp",  "                           - read parameters (pmon per channel, tala, pproc)"},
+  {cmd_mmp, "mmp", "p                         - modify monitoring period of all channels (seconds - 0 deactivate)"},
   {cmd_mta, "mta", "t                         - modify time alarm (seconds)"},
   {cmd_mpp, "mpp", "p                         - modify processing period (seconds - 0 deactivate)"},
-  {cmd_rai, "rai", "                          - read alarm info (clock, temperature, luminosity, active/inactive-A/a)"},
-  {cmd_dac, "dac", "hh:mm:ss                  - define alarm clock"},
+  {cmd_msp, "msp", "T/L ms                    - modify sampling period of one channel (ms - 0 deactivate)"},
+  {cmd_rdm, "rdm", "                          - read missed sampling deadlines (T, L)"},
+  {cmd_mpm, "mpm", "m                         - modify sensor power mode (1 - one-shot, 0 - continuous; one-shot stays awake while a T alarm is armed)"},
+  {cmd_mlf, "mlf", "f                         - modify luminosity filter (1 - oversampled, 0 - single sample)"},
+  {cmd_mcd, "mcd", "T L s                     - modify change-driven logging (hysteresis T tenths of °C, L, heartbeat seconds - 0 log all)"},
+  {cmd_rai, "rai", "                          - read alarm info (clock, temperature, luminosity, active/inactive-A/a, rules)"},
+  {cmd_dac, "dac", "hh:mm:ss                  - add daily alarm clock (00:00:00 - clear all)"},
   {cmd_dtl, "dtl", "T L                       - define alarm temperature and luminosity"},
+  {cmd_dar, "dar", "i [T/L v h E/L n [a]]      - define alarm rule i (v, h in tenths of °C for T; edge/level; n samples; action 1 LCD + 2 telemetry + 4 buzzer) - no values delete"},
+  {cmd_dra, "dra", "r [n]                     - define rate alarm (|slope| >= r tenths of °C/min for n samples - 0 delete)"},
   {cmd_aa,  "aa",  " A/a                       - activate/deactivate alarms (A/a)"},
-  {cmd_cai, "cai", "                          - clear alarm info (letters CTL in LCD)"},
+  {cmd_cai, "cai", "                          - clear alarm info (letters CTLR in LCD)"},
   {cmd_ir,  "ir",  "                           - information about records (NR, nr, wi, ri)"},
   {cmd_lr,  "lr",  " n i                       - list n records from index i (0 - oldest)"},
+  {cmd_er,  "er",  " [c/b] [n] [i]             - export n records from index i (c - CSV, b - binary frames)"},
   {cmd_dr,  "dr",  "                           - delete records"},
-  {cmd_pr,  "pr",  "[hh:mm:ss] [hh:mm:ss]      - process records (max, min, mean) between instants t1 and t2"}
+  {cmd_pr,  "pr",  "[hh:mm:ss] [hh:mm:ss]      - process records (max, min, time-weighted mean, stddev, p50, p90) between t1 and t2"},
+  {cmd_dq,  "dq",  " i T0..T7/L s              - define standing query i (last s seconds of a channel - 0 delete)"},
+  {cmd_rq,  "rq",  "                           - read standing queries (max, min, time-weighted mean)"},
+  {cmd_st,  "st",  " [1/0]                     - subscribe/unsubscribe telemetry (no argument - counters)"}
 };
 
 #define NCOMMANDS  (sizeof(commands)/sizeof(struct command_d))
-#define ARGVECSIZE 3
-#define MAX_LINE   50
+#ifndef ARGVECSIZE
+#define ARGVECSIZE 8   // arguments per command (including its name)
+#endif
+#ifndef MAX_LINE
+#define MAX_LINE   128 // several commands separated by ';' fit in one line
+#endif
+#ifndef HISTORY
+#define HISTORY    4   // lines kept for !! and !n
+#endif
+
+static char history[HISTORY][MAX_LINE]; // history[0] is the most recent line
+static int nhistory = 0;
 
 /*-------------------------------------------------------------------------+
 | Function: cmd_sos - provides a rudimentary help
@@ -71,9 +114,48 @@ void cmd_sos (int argc, char **argv)
 {
   int i;
 
-  printf("%s\n", DescrMsg);
+  cprintf("%s\n", DescrMsg);
   for (i = 0; i < NCOMMANDS; i++)
-    printf("%s %s\n", commands[i].cmd_name, commands[i].cmd_help);
+    cprintf("%s %s\n", commands[i].cmd_name, commands[i].cmd_help);
+}
+
+/*-------------------------------------------------------------------------+
+| Function: cmd_hi - lists the command history (1 - most recent)
++--------------------------------------------------------------------------*/ 
+void cmd_hi (int argc, char **argv)
+{
+  int i;
+
+  for (i = nhistory - 1; i >= 0; i--)
+    cprintf("\n%d %s", i + 1, history[i]);
+  cprintf("\n");
+}
+
+/*-------------------------------------------------------------------------+
+| Function: cprintf, cputs  (console output, one write under xSerialMutex) 
++--------------------------------------------------------------------------*/ 
+void cprintf (const char* format, ...)
+{
+  va_list args;
+
+  // CRITICAL SECTION: a telemetry frame never lands inside a console write
+  xSemaphoreTake(xSerialMutex, portMAX_DELAY);
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  fflush(stdout);
+  xSemaphoreGive(xSerialMutex);
+  // END OF CRITICAL SECTION
+}
+
+void cputs (const char* s)
+{
+  // CRITICAL SECTION
+  xSemaphoreTake(xSerialMutex, portMAX_DELAY);
+  fputs(s, stdout);
+  fflush(stdout);
+  xSemaphoreGive(xSerialMutex);
+  // END OF CRITICAL SECTION
 }
 
 /*-------------------------------------------------------------------------+
@@ -83,38 +165,86 @@ char* my_fgets (char* ln, int sz, FILE* f)
 {
   //fgets(line, MAX_LINE, stdin);
   //pc.gets(line, MAX_LINE);
-  int i; char c;
-  for(i=0; i<sz-1; i++) {
-    c = pc.getc();
-    ln[i] = c;
+  int i = 0; char c;
+  while (i < sz-1) {
+    if (pushback >= 0) { c = pushback; pushback = -1; } // read ahead during an export (see flowControl)
+    else c = pc.getc();
     if ((c == '\n') || (c == '\r')) break;
+    if ((c == '\b') || (c == 0x7f)) { // backspace/delete edits the line
+      if (i > 0) i--;
+      continue;
+    }
+    ln[i++] = c;
   }
   ln[i] = '\0';
 
   return ln;
 }
 
+/*-------------------------------------------------------------------------+
+| Function: my_strtok       (reentrant strtok, state is kept in *save) 
++--------------------------------------------------------------------------*/ 
+char* my_strtok (char* s, const char* delim, char** save)
+{
+  char *token;
+
+  if (s == NULL) s = *save;
+  s += strspn(s, delim);              // skip leading delimiters
+  if (*s == '\0') { *save = s; return NULL; }
+  token = s;
+  s += strcspn(s, delim);             // find the end of the token
+  if (*s != '\0') *s++ = '\0';
+  *save = s;
+  return token;
+}
+
 /*-------------------------------------------------------------------------+
 | Function: my_getline        (called from monitor) 
 +--------------------------------------------------------------------------*/ 
-int my_getline (char** argv, int argvsize)
+char* my_getline (char* line, int sz)
 {
-  static char line[MAX_LINE];
-  char *p;
-  int argc;
+  int n;
 
   //fgets(line, MAX_LINE, stdin);
-  my_fgets(line, MAX_LINE, stdin);
+  my_fgets(line, sz, stdin);
+
+  /* History expansion: "!!" is the last line, "!n" the n-th last ------- */
+  if (line[0] == '!') {
+    n = (line[1] == '!') ? 1 : atoi(line + 1);
+    if (n < 1 || n > nhistory) {
+      cprintf("\nInvalid history entry!\n");
+      line[0] = '\0';
+      return line;
+    }
+    strcpy(line, history[n-1]);
+    cprintf("\n%s", line);
+  }
+  
+  /* Save non-empty lines in the history before they are tokenized ------ */
+  if (line[strspn(line, " \t;")] != '\0' && (nhistory == 0 || strcmp(line, history[0]) != 0)) {
+    memmove(history[1], history[0], (HISTORY-1) * MAX_LINE);
+    strcpy(history[0], line);
+    if (nhistory < HISTORY) nhistory++;
+  }
+  return line;
+}
 
-  /* Break command line into an o.s. like argument vector,
+/*-------------------------------------------------------------------------+
+| Function: my_getargs        (called from monitor) 
++--------------------------------------------------------------------------*/ 
+int my_getargs (char* cmd, char** argv, int argvsize)
+{
+  char *save;
+  int argc;
+
+  /* Break command into an o.s. like argument vector,
      i.e. compliant with the (int argc, char **argv) specification -------- */
 
-  for (argc = 0, p = line; (*line != '\0') && (argc < argvsize); p = NULL, argc++) {
-    p = strtok(p, " \t\n");
-    argv[argc] = p;
-    if (p == NULL) return argc;
+  for (argc = 0; argc < argvsize; argc++) {
+    argv[argc] = my_strtok(argc == 0 ? cmd : NULL, " \t\n", &save);
+    if (argv[argc] == NULL) return argc;
   }
-  argv[argc] = p;
+  argv[argc] = NULL;
   return argc;
 }
 
@@ -123,24 +253,31 @@ int my_getline (char** argv, int argvsize)
 +--------------------------------------------------------------------------*/ 
 void monitor (void)
 {
+  static char line[MAX_LINE];
   static char *argv[ARGVECSIZE+1], *p;
+  char *cmd, *save;
   int argc, i;
 
-  printf("%s\nType sos for help\n", TitleMsg);
+  cprintf("%s\nType sos for help\n", TitleMsg);
   for (;;) {
-    printf("\nCMD> ");
-    /* Reading and parsing command line  ----------------------------------*/
-    if ((argc = my_getline(argv, ARGVECSIZE)) > 0) 
+    cprintf("\nCMD> ");
+    /* Reading the command line, commands are separated by ';' ------------*/
+    my_getline(line, MAX_LINE);
+    for (cmd = my_strtok(line, ";", &save); cmd != NULL; cmd = my_strtok(NULL, ";", &save))
     {
-      for (p = argv[0]; *p != '\0'; *p = tolower(*p), p++);
-      for (i = 0; i < NCOMMANDS; i++) 
-      if (strcmp(argv[0], commands[i].cmd_name) == 0) 
-        break;
-      /* Executing commands -----------------------------------------------*/
-      if (i < NCOMMANDS)
-        commands[i].cmd_fnct(argc, argv);
-      else  
-        printf("%s", InvalMsg);
+      /* Parsing command ------------------------------------------------- */
+      if ((argc = my_getargs(cmd, argv, ARGVECSIZE)) > 0) 
+      {
+        for (p = argv[0]; *p != '\0'; *p = tolower(*p), p++);
+        for (i = 0; i < NCOMMANDS; i++) 
+        if (strcmp(argv[0], commands[i].cmd_name) == 0) 
+          break;
+        /* Executing commands ---------------------------------------------*/
+        if (i < NCOMMANDS)
+          commands[i].cmd_fnct(argc, argv);
+        else  
+          cprintf("%s", InvalMsg);
+      }
     }
   } // forever
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "parse.h"
+
+bool parseTime(const char *arg, Time *time)
+{
+  // arg must be exactly "hh:mm:ss"
+  for (uint8_t i = 0; i < 8; i++)
+    if (arg[i] == '\0') return false; // too short, don't read past the end
+
+  // Unsigned subtraction maps any non-digit above 9, so one compare checks each digit
+  uint8_t h1 = arg[0] - '0', h0 = arg[1] - '0';
+  uint8_t m1 = arg[3] - '0', m0 = arg[4] - '0';
+  uint8_t s1 = arg[6] - '0', s0 = arg[7] - '0';
+  uint8_t h = h1 * 10 + h0;
+  bool valid = (h1 <= 2) & (h0 <= 9) & (h <= 23)
+             & (m1 <= 5) & (m0 <= 9)
+             & (s1 <= 5) & (s0 <= 9)
+             & (arg[2] == ':') & (arg[5] == ':') & (arg[8] == '\0');
+  
+  if (!valid) return false;
+  *time = h * 3600 + (m1 * 10 + m0) * 60 + s1 * 10 + s0;
+  return true;
+}
@@ -0,0 +1,12 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef PARSE_H
+#define PARSE_H
+
+// Command argument parsing, the inverse of fmt.h. Arguments are only read,
+// never modified, so the same argv can be parsed again.
+
+bool parseTime(const char *arg, Time *time); // exactly "hh:mm:ss" -> seconds since midnight, false if malformed
+
+#endif /* PARSE_H */
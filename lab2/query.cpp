@@ -0,0 +1,130 @@
+#include "query.h"
+
+typedef struct
+{
+  uint8_t channel;
+  Tick window;                 // 0 --> not set
+  uint8_t head, tail;          // FIFO [head, tail), positions modulo 256
+  Tick stamp[QUERY_DEPTH];
+  int16_t value[QUERY_DEPTH];
+  int64_t sum;                 // value x hold of every record but the newest (held until now)
+  uint8_t max[QUERY_DEPTH];    // FIFO slots, values decreasing from the front
+  uint8_t min[QUERY_DEPTH];    // FIFO slots, values increasing from the front
+  uint8_t maxh, maxt, minh, mint;
+  Tick dropped;                // hold end of the last record dropped for lack of depth (0 --> none)
+} Query;
+
+static Query queries[QUERIES];
+
+#define SLOT(n) ((uint8_t)(n) % QUERY_DEPTH)
+
+static void clear(Query *q)
+{
+  q->head = q->tail = 0;
+  q->maxh = q->maxt = q->minh = q->mint = 0;
+  q->sum = 0;
+  q->dropped = 0;
+}
+
+static void popFront(Query *q)
+{
+  uint8_t h = SLOT(q->head), n = SLOT(q->head + 1);
+  
+  if ((uint8_t)(q->tail - q->head) > 1) q->sum -= (int64_t)q->value[h] * (q->stamp[n] - q->stamp[h]);
+  if (q->maxt != q->maxh && q->max[SLOT(q->maxh)] == h) q->maxh++;
+  if (q->mint != q->minh && q->min[SLOT(q->minh)] == h) q->minh++;
+  q->head++;
+}
+
+static void evict(Query *q, Tick now)
+{
+  // Drop the records whose hold ended before the window (the front one may still be held into it)
+  Tick from = now > q->window ? now - q->window : 0;
+  while ((uint8_t)(q->tail - q->head) > 1 && q->stamp[SLOT(q->head + 1)] <= from)
+    popFront(q);
+}
+
+static void append(Query *q, Tick stamp, int16_t v)
+{
+  uint8_t k = SLOT(q->tail), last = SLOT(q->tail - 1);
+  
+  if ((uint8_t)(q->tail - q->head) == QUERY_DEPTH)
+  {
+    popFront(q);
+    q->dropped = q->stamp[SLOT(q->head)]; // it was held until the new front record
+  }
+  if (q->tail != q->head) q->sum += (int64_t)q->value[last] * (stamp - q->stamp[last]);
+  q->stamp[k] = stamp;
+  q->value[k] = v;
+  // A record is never again the max (min) once a later one is at least as high (low)
+  while (q->maxt != q->maxh && q->value[q->max[SLOT(q->maxt - 1)]] <= v) q->maxt--;
+  q->max[SLOT(q->maxt++)] = k;
+  while (q->mint != q->minh && q->value[q->min[SLOT(q->mint - 1)]] >= v) q->mint--;
+  q->min[SLOT(q->mint++)] = k;
+  q->tail++;
+  evict(q, stamp);
+}
+
+bool querySet(uint8_t i, uint8_t channel, Tick window)
+{
+  if (i >= QUERIES || channel > QUERY_LUM) return false;
+  queries[i].channel = channel;
+  queries[i].window = window;
+  clear(&queries[i]);
+  return true;
+}
+
+bool queryGet(uint8_t i, uint8_t *channel, Tick *window)
+{
+  if (i >= QUERIES || queries[i].window == 0) return false;
+  *channel = queries[i].channel;
+  *window = queries[i].window;
+  return true;
+}
+
+void queryAdd(uint8_t i, const Record *record)
+{
+  Query *q = &queries[i];
+  if (q->window == 0) return;
+  append(q, record->stamp, q->channel == QUERY_LUM ? record->luminosity : record->temperature[q->channel]);
+}
+
+void queryAppend(const Record *record)
+{
+  for (uint8_t i = 0; i < QUERIES; i++)
+    queryAdd(i, record);
+}
+
+bool queryRead(uint8_t i, Tick now, QueryResult *result)
+{
+  Query *q;
+  uint8_t h, l;
+  Tick from, weight;
+  int64_t sum;
+  
+  if (i >= QUERIES || queries[i].window == 0) return false;
+  q = &queries[i];
+  evict(q, now);
+  from = now > q->window ? now - q->window : 0;
+  result->empty = q->tail == q->head;
+  result->truncated = q->dropped > from; // once the window has moved past it, the result is whole again
+  if (result->empty) return true;
+  
+  h = SLOT(q->head); l = SLOT(q->tail - 1);
+  // Newest record held until now, front record clipped to the window
+  sum = q->sum + (int64_t)q->value[l] * (now - q->stamp[l]);
+  if (q->stamp[h] < from) sum -= (int64_t)q->value[h] * (from - q->stamp[h]);
+  weight = now - (q->stamp[h] > from ? q->stamp[h] : from);
+  if (q->channel == QUERY_LUM) sum *= 10; // tenths
+  if (weight == 0) result->mean = q->channel == QUERY_LUM ? q->value[l] * 10 : q->value[l]; // one record, stamped now
+  else result->mean = (sum + (sum < 0 ? -(int64_t)(weight / 2) : (int64_t)(weight / 2))) / (int64_t)weight;
+  result->max = q->value[q->max[SLOT(q->maxh)]];
+  result->min = q->value[q->min[SLOT(q->minh)]];
+  return true;
+}
+
+void queryReset(void)
+{
+  for (uint8_t i = 0; i < QUERIES; i++)
+    clear(&queries[i]);
+}
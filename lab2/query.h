@@ -0,0 +1,34 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef QUERY_H
+#define QUERY_H
+
+// Standing sliding-window queries ("last N seconds of one channel"). Each one
+// keeps the records held in its window in a small FIFO, with the running
+// time-weighted sum and monotonic deques for max and min, updated as records
+// are appended and as they leave the window. A result is read in O(1)
+// (amortized) instead of rescanning the history. All calls are made with
+// xBufferMutex taken.
+
+#define QUERIES     4  // standing queries
+#define QUERY_DEPTH 32 // records kept per query (power of 2, divides 256)
+#define QUERY_LUM   NTS // channel number of L (0 .. NTS-1 are the T sensors)
+
+typedef struct
+{
+  int16_t max;   // Temp for T, 0..3 for L
+  int16_t min;
+  int16_t mean;  // time-weighted, Temp for T, tenths for L
+  bool empty;    // no record in the window
+  bool truncated; // more than QUERY_DEPTH records in the window: only the newest ones are covered
+} QueryResult;
+
+bool querySet(uint8_t i, uint8_t channel, Tick window); // window 0 removes query i
+bool queryGet(uint8_t i, uint8_t *channel, Tick *window); // false if not set
+void queryAdd(uint8_t i, const Record *record);         // one query (seeding from the ring)
+void queryAppend(const Record *record);                 // every query
+bool queryRead(uint8_t i, Tick now, QueryResult *result); // false if not set
+void queryReset(void);                                  // records deleted, queries kept
+
+#endif /* QUERY_H */
@@ -0,0 +1,139 @@
+#include "rollup.h"
+
+// Open (still filling) bucket, with exact sums
+typedef struct
+{
+  uint32_t index;
+  Tick weight;
+  Temp minT[NTS];
+  Temp maxT[NTS];
+  int64_t sumT[NTS];
+  uint8_t minL;
+  uint8_t maxL;
+  uint64_t sumL;
+  bool used;
+} Acc;
+
+static Bucket minutes[ROLLUP_MINUTES], hours[ROLLUP_HOURS];
+static Acc minute, hour;
+static Tick closed = 0;
+
+static void accOpen(Acc *a, uint32_t index)
+{
+  a->index = index;
+  a->weight = 0;
+  for (uint8_t c = 0; c < NTS; c++) { a->minT[c] = TEMP_MAX; a->maxT[c] = -TEMP_MAX; a->sumT[c] = 0; }
+  a->minL = 4; a->maxL = 0; a->sumL = 0;
+  a->used = true;
+}
+
+static void accMerge(Acc *into, const Acc *from)
+{
+  for (uint8_t c = 0; c < NTS; c++)
+  {
+    if (from->minT[c] < into->minT[c]) into->minT[c] = from->minT[c];
+    if (from->maxT[c] > into->maxT[c]) into->maxT[c] = from->maxT[c];
+    into->sumT[c] += from->sumT[c];
+  }
+  if (from->minL < into->minL) into->minL = from->minL;
+  if (from->maxL > into->maxL) into->maxL = from->maxL;
+  into->sumL += from->sumL;
+  into->weight += from->weight;
+}
+
+static void accClose(Acc *a, Bucket *b)
+{
+  // Sums become means (rounded), the exact sums are not kept
+  b->index = a->index;
+  b->weight = a->weight;
+  for (uint8_t c = 0; c < NTS; c++)
+  {
+    b->minT[c] = a->minT[c];
+    b->maxT[c] = a->maxT[c];
+    b->meanT[c] = (a->sumT[c] + (a->sumT[c] < 0 ? -(int64_t)(a->weight / 2) : (int64_t)(a->weight / 2))) / (int64_t)a->weight;
+  }
+  b->minL = a->minL;
+  b->maxL = a->maxL;
+  b->meanL = (a->sumL * 10 + a->weight / 2) / a->weight;
+  a->used = false;
+}
+
+static void closeMinute(void)
+{
+  uint32_t h = minute.index / 60;
+  
+  // Closed minutes roll up into the hour they belong to
+  if (hour.used && hour.index != h) accClose(&hour, &hours[hour.index % ROLLUP_HOURS]);
+  if (!hour.used) accOpen(&hour, h);
+  accMerge(&hour, &minute);
+  closed = (Tick)(minute.index + 1) * MINUTE_TICKS;
+  if (minute.index % 60 == 59) accClose(&hour, &hours[h % ROLLUP_HOURS]);
+  accClose(&minute, &minutes[minute.index % ROLLUP_MINUTES]);
+}
+
+void rollupHold(const Record *record, Tick from, Tick to)
+{
+  Tick edge, part;
+  uint32_t m;
+  
+  // Anything older than both rings is of no use (a long silence would only loop here)
+  if (to - from > (ROLLUP_HOURS + 1) * HOUR_TICKS) from = to - (ROLLUP_HOURS + 1) * HOUR_TICKS;
+  // Split [from, to) at minute edges
+  while (from < to)
+  {
+    m = from / MINUTE_TICKS;
+    edge = (Tick)(m + 1) * MINUTE_TICKS;
+    part = (to < edge ? to : edge) - from;
+    if (minute.used && minute.index != m) closeMinute();
+    if (!minute.used) accOpen(&minute, m);
+    for (uint8_t c = 0; c < NTS; c++)
+    {
+      if (record->temperature[c] < minute.minT[c]) minute.minT[c] = record->temperature[c];
+      if (record->temperature[c] > minute.maxT[c]) minute.maxT[c] = record->temperature[c];
+      minute.sumT[c] += (int64_t)record->temperature[c] * part;
+    }
+    if (record->luminosity < minute.minL) minute.minL = record->luminosity;
+    if (record->luminosity > minute.maxL) minute.maxL = record->luminosity;
+    minute.sumL += record->luminosity * part;
+    minute.weight += part;
+    from += part;
+    if (from == edge) closeMinute();
+  }
+}
+
+void rollupReset(void)
+{
+  for (uint8_t i = 0; i < ROLLUP_MINUTES; i++) minutes[i].weight = 0;
+  for (uint8_t i = 0; i < ROLLUP_HOURS; i++) hours[i].weight = 0;
+  minute.used = false;
+  hour.used = false;
+  closed = 0;
+}
+
+Tick rollupClosed(void)
+{
+  return closed;
+}
+
+static bool inside(const Bucket *b, Tick span, Tick start, Tick end)
+{
+  Tick from = b->index * span;
+  return b->weight != 0 && from >= start && from + span <= end;
+}
+
+bool rollupBucket(uint8_t i, Tick start, Tick end, Bucket *bucket)
+{
+  if (i < ROLLUP_HOURS)
+  {
+    if (!inside(&hours[i], HOUR_TICKS, start, end)) return false;
+    *bucket = hours[i];
+    return true;
+  }
+  const Bucket *b = &minutes[i - ROLLUP_HOURS];
+  if (!inside(b, MINUTE_TICKS, start, end)) return false;
+  // Already counted in its hour bucket
+  const Bucket *h = &hours[b->index / 60 % ROLLUP_HOURS];
+  if (h->index == b->index / 60 && inside(h, HOUR_TICKS, start, end)) return false;
+  *bucket = *b;
+  return true;
+}
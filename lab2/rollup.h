@@ -0,0 +1,38 @@
+#include <cstdint>
+#include "FreeRTOS.h"
+#include "shared.h"
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+// Downsampled history: as records are appended, the time each value was held
+// is accumulated into minute buckets, and closed minutes into hour buckets,
+// both kept in fixed-size rings. pr reads whole buckets for the part of an
+// interval older than the raw records, so a 24 h query touches a few dozen
+// buckets. All calls are made with xBufferMutex taken.
+
+#define ROLLUP_MINUTES 60 // last hour at minute resolution
+#define ROLLUP_HOURS   24 // last day at hour resolution
+#define ROLLUP_BUCKETS (ROLLUP_HOURS + ROLLUP_MINUTES)
+#define MINUTE_TICKS ((Tick)60 * configTICK_RATE_HZ)
+#define HOUR_TICKS   (60 * MINUTE_TICKS)
+
+typedef struct
+{
+  uint32_t index;  // bucket number since boot (start tick / span)
+  uint32_t weight; // ticks covered, 0 if the bucket is empty
+  Temp minT[NTS];
+  Temp maxT[NTS];
+  Temp meanT[NTS]; // time-weighted
+  uint8_t minL;
+  uint8_t maxL;
+  uint16_t meanL;  // tenths, time-weighted
+} Bucket;
+
+void rollupHold(const Record *record, Tick from, Tick to); // record's values were held over [from, to)
+void rollupReset(void);
+Tick rollupClosed(void);                                   // end of the last closed minute
+bool rollupBucket(uint8_t i, Tick start, Tick end, Bucket *bucket); // copy of bucket i (0 .. ROLLUP_BUCKETS-1) if it
+                                                                    // lies in [start, end) and isn't inside a used hour
+
+#endif /* ROLLUP_H */
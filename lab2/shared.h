@@ -4,26 +4,47 @@
 #define SHARED_H
 
 #define NR 20 // maximum size of the buffer
+#define NTS 8 // temperature channels (LM75B ADDRESS_0 .. ADDRESS_7, only the ones found are polled)
 #define INVALID -1
+#define SOF 0x7E // start of a binary frame (record export and telemetry)
+#define TLM_QUEUE 8 // telemetry frames waiting to be sent
+#define LM75B_CONV_MS 120 // LM75B conversion after power-up (100 ms typical, plus margin)
+#define SAMPLE_MIN_MS 50 // shortest sampling period of a channel
+#define PWM_PERIOD_US 20000 // mbed default PWM period (shared by all LPC1768 PWM outputs)
 
 // Used for tasks receiving data from multiple sources
 typedef enum
 {
   TIMER,
-  CONSOLE
+  CONSOLE,
+  WAKEUP   // one-shot mode: power up the LM75B ahead of the next TIMER sample
 } Sender;
 
-typedef struct 
+// Sampling channels, each with its own period
+typedef enum
+{
+  CH_TEMP,
+  CH_LUM,
+  NCH
+} Channel;
+
+#define CH_ALL ((1 << NCH) - 1)
+
+// Timer/Console -> Sensors
+typedef struct
 {
-  short hours;
-  short minutes;
-  short seconds;
-} Time;
+  Sender sender;
+  uint8_t channels; // bit (1 << Channel) set for each channel to sample
+} SensorRequest;
+
+typedef int32_t Time; // seconds since midnight (INVALID if not given)
+typedef uint64_t Tick; // FreeRTOS ticks since boot, never wraps (see timebase.h)
+#define TICK_INVALID UINT64_MAX
 
 typedef struct 
 {
-  Time time1;
-  Time time2;
+  Tick start; // first tick in the interval (TICK_INVALID if not given)
+  Tick end;   // last tick in the interval (TICK_INVALID if not given)
 } Interval;
 
 // Console/Timer -> Processing
@@ -33,32 +54,56 @@ typedef struct
   Sender sender;
 } InputData;
 
+// Temperature in Q3 fixed point (1/8 °C, the LM75B resolution), no float math on the M3
+typedef int16_t Temp;
+#define TEMP_Q 3
+#define TEMP_C(t) ((Temp)((t) * (1 << TEMP_Q))) // whole °C to Temp (also negative, so no <<)
+#define TEMP_MAX INT16_MAX
+
 // Sensors -> Console
 typedef struct
 {
-  uint8_t temp;
+  Temp temp[NTS];
   uint8_t lum;
+  uint16_t lum16; // full resolution luminosity
 } Sensor;
 
 // Sensors -> memory, memory -> Processing
 typedef struct
 {
-  uint8_t hours;
-  uint8_t minutes;
-  uint8_t seconds;
-  uint8_t temperature;
+  Tick stamp; // sample time, wall clock applied only when displayed
   uint8_t luminosity;
+  Temp temperature[NTS]; // per channel
 } Record;
 
 // Processing -> Console
 typedef struct
 {
-  uint8_t maxT;
-  uint8_t minT;
-  float meanT;
+  Temp maxT[NTS];  // per channel
+  Temp minT[NTS];
+  Temp meanT[NTS]; // rounded to the Q3 resolution
+  Temp sdT[NTS];   // standard deviation
+  Temp p50T[NTS];  // approximate percentiles (see stats.h)
+  Temp p90T[NTS];
   uint8_t maxL;
   uint8_t minL;
-  float meanL;
+  uint16_t meanL; // tenths
+  uint16_t sdL;   // tenths
+  bool empty;     // no record in the interval, the fields above are meaningless
 } OutputData;
 
+// Sensors/Clock -> Telemetry
+typedef enum
+{
+  TLM_RECORD = 'R', // data = record in the wire.h layout
+  TLM_ALARM = 'A'   // data[0] = 'C', 'T', 'L' or 'R'
+} TelemetryType;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t len;               // bytes of data sent
+  uint8_t data[9 + 2 * NTS]; // WIRE_RECORD_MAX (wire.h)
+} Telemetry;
+
 #endif /* SHARED_H */
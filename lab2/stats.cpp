@@ -0,0 +1,80 @@
+#include "stats.h"
+
+void welfordInit(Welford *w)
+{
+  w->weight = 0;
+  w->mean = 0;
+  w->var = 0;
+}
+
+void welfordAdd(Welford *w, int32_t x, uint32_t weight)
+{
+  int32_t d1, d2;
+  
+  if (weight == 0) return;
+  x *= 1 << WELFORD_FRAC; // not <<: x may be negative
+  w->weight += weight;
+  d1 = x - w->mean;
+  w->mean += (int64_t)d1 * weight / (int64_t)w->weight;
+  d2 = x - w->mean;
+  // var' = var + weight * (d1 * d2 - var) / W, i.e. S/W kept directly so S can't overflow
+  w->var += ((int64_t)d1 * d2 - w->var) * weight / (int64_t)w->weight;
+}
+
+static uint32_t isqrt(uint64_t v)
+{
+  // Bit-by-bit integer square root (floor)
+  uint64_t root = 0, bit = (uint64_t)1 << 62;
+  
+  while (bit > v) bit >>= 2;
+  while (bit != 0)
+  {
+    if (v >= root + bit)
+    {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else root >>= 1;
+    bit >>= 2;
+  }
+  return root;
+}
+
+int32_t welfordStddev(Welford *w)
+{
+  if (w->var <= 0) return 0;
+  // sqrt of Q(2*FRAC) is Q(FRAC), rounded back to the unit of x
+  return (isqrt(w->var) + (1 << (WELFORD_FRAC - 1))) >> WELFORD_FRAC;
+}
+
+void sketchInit(Sketch *s)
+{
+  for (uint8_t b = 0; b < SKETCH_BINS; b++) s->bins[b] = 0;
+  s->weight = 0;
+}
+
+void sketchAdd(Sketch *s, Temp x, uint32_t weight)
+{
+  int32_t b = (x - SKETCH_MIN) >> TEMP_Q; // 1 °C per bin
+  
+  if (b < 0) b = 0;
+  if (b >= SKETCH_BINS) b = SKETCH_BINS - 1;
+  // Saturate instead of wrapping (a bin holds about 49 days of ticks)
+  s->bins[b] = s->bins[b] + weight < s->bins[b] ? UINT32_MAX : s->bins[b] + weight;
+  s->weight += weight;
+}
+
+Temp sketchQuantile(Sketch *s, uint8_t percent)
+{
+  uint64_t target = s->weight * percent / 100, below = 0;
+  
+  if (s->weight == 0) return 0;
+  for (uint8_t b = 0; b < SKETCH_BINS; b++)
+  {
+    if (s->bins[b] != 0 && below + s->bins[b] >= target)
+      // Linear interpolation inside the bin
+      return SKETCH_MIN + TEMP_C(b) + (Temp)((target - below) * TEMP_C(1) / s->bins[b]);
+    below += s->bins[b];
+  }
+  return SKETCH_MIN + TEMP_C(SKETCH_BINS) - 1;
+}
@@ -0,0 +1,36 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef STATS_H
+#define STATS_H
+
+// Single-pass, fixed-point summaries used by pr. Samples are weighted (by the
+// ticks they were held), so a faster sampling period doesn't bias the result.
+
+#define WELFORD_FRAC 4        // extra fractional bits of the running mean (Q3 -> Q7)
+#define SKETCH_BINS  64       // percentile sketch: 1 °C bins ...
+#define SKETCH_MIN   TEMP_C(-10) // ... from -10 °C (values outside go to the end bins)
+
+// Weighted Welford (West) running variance, mean in Q(3+WELFORD_FRAC), variance in its square
+typedef struct
+{
+  uint64_t weight;
+  int32_t mean;
+  int64_t var;
+} Welford;
+
+// Weighted histogram, quantiles interpolated inside a bin (error below 1 °C)
+typedef struct
+{
+  uint32_t bins[SKETCH_BINS];
+  uint64_t weight;
+} Sketch;
+
+void welfordInit(Welford *w);
+void welfordAdd(Welford *w, int32_t x, uint32_t weight); // x in Q3 (Temp) or any integer unit
+int32_t welfordStddev(Welford *w);                        // same unit as x
+void sketchInit(Sketch *s);
+void sketchAdd(Sketch *s, Temp x, uint32_t weight);
+Temp sketchQuantile(Sketch *s, uint8_t percent);         // 0 if empty
+
+#endif /* STATS_H */
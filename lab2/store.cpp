@@ -0,0 +1,79 @@
+#include <string.h>
+#include "store.h"
+
+#if RECORD_SOA
+static Tick stamps[NR];
+static Temp temps[NTS][NR]; // one column per channel
+static uint8_t lums[NR];
+#else
+static Record records[NR];
+#endif
+
+void storeWrite(uint8_t i, const Record *record)
+{
+#if RECORD_SOA
+  stamps[i] = record->stamp;
+  for (uint8_t c = 0; c < NTS; c++) temps[c][i] = record->temperature[c];
+  lums[i] = record->luminosity;
+#else
+  records[i] = *record;
+#endif
+}
+
+void storeRead(uint8_t i, Record *record)
+{
+#if RECORD_SOA
+  record->stamp = stamps[i];
+  for (uint8_t c = 0; c < NTS; c++) record->temperature[c] = temps[c][i];
+  record->luminosity = lums[i];
+#else
+  *record = records[i];
+#endif
+}
+
+Tick storeStamp(uint8_t i)
+{
+#if RECORD_SOA
+  return stamps[i];
+#else
+  return records[i].stamp;
+#endif
+}
+
+void storeColumns(uint8_t i, uint8_t n, Tick *stamp, Temp *temp, uint8_t stride, uint8_t nt, uint8_t *lum)
+{
+#if RECORD_SOA
+  // At most two contiguous runs per column (the ring may wrap). Plain loops: the
+  // runs are AGG_CHUNK records at most, a memcpy call per column costs more.
+  uint8_t run = n < NR - i ? n : NR - i;
+  for (uint8_t k = 0; k < run; k++) stamp[k] = stamps[i + k];
+  for (uint8_t k = run; k < n; k++) stamp[k] = stamps[k - run];
+  for (uint8_t c = 0; c < nt; c++)
+  {
+    Temp *t = temp + c * stride;
+    for (uint8_t k = 0; k < run; k++) t[k] = temps[c][i + k];
+    for (uint8_t k = run; k < n; k++) t[k] = temps[c][k - run];
+  }
+  for (uint8_t k = 0; k < run; k++) lum[k] = lums[i + k];
+  for (uint8_t k = run; k < n; k++) lum[k] = lums[k - run];
+#else
+  for (uint8_t k = 0; k < n; k++)
+  {
+    const Record *r = &records[(i + k) % NR];
+    stamp[k] = r->stamp;
+    for (uint8_t c = 0; c < nt; c++) temp[c * stride + k] = r->temperature[c];
+    lum[k] = r->luminosity;
+  }
+#endif
+}
+
+void storeClear(void)
+{
+#if RECORD_SOA
+  memset(stamps, 0, sizeof(stamps));
+  memset(temps, 0, sizeof(temps));
+  memset(lums, 0, sizeof(lums));
+#else
+  memset(records, 0, sizeof(records));
+#endif
+}
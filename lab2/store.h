@@ -0,0 +1,24 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef STORE_H
+#define STORE_H
+
+// Record ring storage (NR records, addressed by physical index; the ring
+// indices nr/wi/ri/nw stay with their users). With RECORD_SOA each field is
+// its own array, so a pr scan copies only the channels in use and the records
+// carry no padding; RECORD_SOA 0 keeps the plain Record array.
+// All calls are made with xBufferMutex taken.
+
+#ifndef RECORD_SOA
+#define RECORD_SOA 1
+#endif
+
+void storeWrite(uint8_t i, const Record *record);
+void storeRead(uint8_t i, Record *record);
+Tick storeStamp(uint8_t i);
+void storeColumns(uint8_t i, uint8_t n, Tick *stamp, Temp *temp, uint8_t stride, uint8_t nt, uint8_t *lum); // n records from i
+                                                                                  // (wrapping), channel c < nt at temp + c * stride
+void storeClear(void);
+
+#endif /* STORE_H */
@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+#ifndef CHECK_H
+#define CHECK_H
+
+// Shared by the host tests (one per program): EXPECT prints the first 10
+// failures and counts all of them, checkDone prints the verdict and returns
+// the exit status of main.
+
+static int failures = 0;
+
+#define EXPECT(cond, ...) do { if (!(cond) && failures++ < 10) { printf("FAIL " __VA_ARGS__); printf("\n"); } } while (0)
+
+static inline int checkDone(void)
+{
+  if (failures) printf("%d failures\n", failures);
+  else printf("OK\n");
+  return failures != 0;
+}
+
+#endif /* CHECK_H */
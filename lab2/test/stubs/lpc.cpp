@@ -0,0 +1,129 @@
+#include "mbed.h"
+#include "sim.h"
+
+// LPC1768 I2C2 controller and ADC as acq.cpp drives them (see sim.h)
+
+extern "C" void acqI2CHandler(void);
+extern "C" void acqADCHandler(void);
+
+#define I2C_AA  0x04
+#define I2C_SI  0x08
+#define I2C_STO 0x10
+#define I2C_STA 0x20
+#define NONE    1e300
+
+static LPC_I2C_TypeDef i2c2;
+static LPC_ADC_TypeDef adc;
+LPC_I2C_TypeDef *LPC_I2C2 = &i2c2;
+LPC_ADC_TypeDef *LPC_ADC = &adc;
+
+bool simNotified;
+double simAdcUs = 65 / 13.0;
+static uint16_t midScale(void) { return 0x800; }
+uint16_t (*simAdcInput)(void) = midScale;
+
+static bool i2cIrq, adcIrq;
+uint32_t simI2CON;
+static bool busy;                 // between START and STOP
+static double i2cNext = NONE;     // the byte/condition in progress completes (SI set)
+static uint32_t i2cStat;          // I2STAT once it completes
+static SimLM75B *slave;           // addressed sensor
+static uint8_t byte;              // bytes read from it
+static double adcNext = NONE;
+static void (*tickerFn)(void);
+static double tickerNext = NONE, tickerUs;
+
+void NVIC_EnableIRQ(IRQn_Type irq) { if (irq == I2C2_IRQn) i2cIrq = true; else adcIrq = true; }
+void NVIC_DisableIRQ(IRQn_Type irq) { if (irq == I2C2_IRQn) i2cIrq = false; else adcIrq = false; }
+
+void Ticker::attach_us(void (*fptr)(void), int us) { tickerFn = fptr; tickerUs = us; tickerNext = simUs + us; }
+void Ticker::detach(void) { tickerNext = NONE; }
+
+static double bits(int n) { simBits += n; return n * 1e6 / SIM_I2C_HZ; }
+
+static void i2cApply(void)
+{
+  // Start the next bus action from what the CPU left in I2CON
+  uint32_t &con = simI2CON;
+  if ((con & I2C_SI) || i2cNext != NONE) return; // waiting for the ISR, or already shifting
+  if (con & I2C_STO)
+  {
+    if (busy) bits(1);
+    busy = false;
+    con &= ~I2C_STO;
+    if (!(con & I2C_STA)) return;
+  }
+  if (con & I2C_STA)
+  {
+    i2cNext = simUs + bits(1);
+    i2cStat = busy ? 0x10 : 0x08;
+    busy = true;
+    return;
+  }
+  if (!busy) return;
+  switch (i2cStat)
+  {
+    case 0x08: case 0x10: // address byte in I2DAT
+    {
+      int i = (i2c2.I2DAT >> 1) - 0x48;
+      slave = (i >= 0 && i < SIM_SENSORS && simSensor[i].present) ? &simSensor[i] : NULL;
+      if (slave == NULL) simNacks++;
+      else simReads++;
+      byte = 0;
+      i2cNext = simUs + bits(9);
+      i2cStat = slave ? 0x40 : 0x48;
+      break;
+    }
+    case 0x40: case 0x50: // receive the next byte, ACK it if AA is set
+    {
+      uint16_t value = slave->pointer == 0 ? simTempRegister(slave) : 0xFFFF;
+      i2c2.I2DAT = byte++ % 2 == 0 ? value >> 8 : value & 0xFF;
+      i2cNext = simUs + bits(9);
+      i2cStat = (con & I2C_AA) ? 0x50 : 0x58;
+      break;
+    }
+  }
+}
+
+static void adcApply(void)
+{
+  // A conversion starts when START = 001 is written and none is running
+  if (adcNext == NONE && ((adc.ADCR >> 24) & 7) == 1)
+    adcNext = simUs + simAdcUs;
+}
+
+void simRun(double until)
+{
+  for (;;)
+  {
+    i2cApply();
+    adcApply();
+    if (simNotified) return;
+    double next = i2cNext < adcNext ? i2cNext : adcNext;
+    if (tickerNext < next) next = tickerNext;
+    if (next > until)
+    {
+      if (until > simUs) simUs = until;
+      return;
+    }
+    simUs = next;
+    if (next == i2cNext)
+    {
+      i2cNext = NONE;
+      i2c2.I2STAT = i2cStat;
+      simI2CON |= I2C_SI;
+      if (i2cIrq) acqI2CHandler();
+    }
+    else if (next == adcNext)
+    {
+      adcNext = NONE;
+      adc.ADDR4 = (1u << 31) | ((simAdcInput() & 0xFFF) << 4);
+      if (adcIrq && (adc.ADINTEN & (1 << 4))) acqADCHandler();
+    }
+    else
+    {
+      tickerNext += tickerUs;
+      tickerFn();
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef MBED_H
+#define MBED_H
+
+// Host stand-in for the parts of mbed used by the modules under test.
+// I2C talks to the simulated LM75B bus of sim.h; the LPC1768 I2C2 and ADC
+// registers, the NVIC and Ticker are modelled by the same simulation.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef enum { p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18, p19, p20,
+               p21, p22, p23, p24, p25, p26, p27, p28, p29, p30, LED1, LED2, LED3, LED4,
+               USBTX, USBRX, NC = -1 } PinName;
+
+#define MBED_OPERATORS 1
+
+class I2C
+{
+public:
+  I2C(PinName sda, PinName scl) {}
+  void frequency(int hz) {}
+  int write(int address, const char *data, int length, bool repeated = false); // 0 on ACK
+  int read(int address, char *data, int length, bool repeated = false);        // 0 on ACK
+};
+
+class Ticker
+{
+public:
+  void attach_us(void (*fptr)(void), int us); // one ticker at a time in the simulation
+  void detach(void);
+};
+
+// I2CONSET/I2CONCLR are write-only views of I2CON: a write sets or clears bits in place
+extern uint32_t simI2CON;
+struct SimConSet { SimConSet &operator=(uint32_t value) { simI2CON |= value; return *this; } };
+struct SimConClr { SimConClr &operator=(uint32_t value) { simI2CON &= ~value; return *this; } };
+
+typedef struct
+{
+  SimConSet I2CONSET;
+  volatile uint32_t I2STAT, I2DAT;
+  SimConClr I2CONCLR;
+} LPC_I2C_TypeDef;
+
+typedef struct
+{
+  volatile uint32_t ADCR, ADINTEN, ADDR4;
+} LPC_ADC_TypeDef;
+
+extern LPC_I2C_TypeDef *LPC_I2C2;
+extern LPC_ADC_TypeDef *LPC_ADC;
+
+typedef enum { I2C2_IRQn = 12, ADC_IRQn = 22 } IRQn_Type;
+
+#define NVIC_SetVector(irq, vector) ((void)(irq)) // the simulation calls the acq handlers by name
+#define NVIC_SetPriority(irq, priority) ((void)(irq))
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+
+#endif
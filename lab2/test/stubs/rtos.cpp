@@ -0,0 +1,42 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sim.h"
+
+// The single task under test: its notification value and the tick count
+// come from the simulation (sim.h), where time passes only while it waits.
+
+static uint32_t notification;
+
+extern "C" void vPortEnterCritical(void) {}
+extern "C" void vPortExitCritical(void) {}
+void vPortYield(void) {}
+
+TickType_t xTaskGetTickCount(void)
+{
+  return (TickType_t)(simUs / 1000);
+}
+
+BaseType_t xTaskGenericNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction,
+                                     uint32_t *pulPreviousNotificationValue, BaseType_t *pxHigherPriorityTaskWoken)
+{
+  if (eAction == eSetBits) notification |= ulValue;
+  else notification = ulValue;
+  simNotified = true;
+  if (pxHigherPriorityTaskWoken) *pxHigherPriorityTaskWoken = pdTRUE;
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit,
+                           uint32_t *pulNotificationValue, TickType_t xTicksToWait)
+{
+  if (!simNotified)
+  {
+    notification &= ~ulBitsToClearOnEntry;
+    if (xTicksToWait > 0) simRun(simUs + xTicksToWait * 1000.0);
+  }
+  if (!simNotified) return pdFALSE;
+  if (pulNotificationValue) *pulNotificationValue = notification;
+  notification &= ~ulBitsToClearOnExit;
+  simNotified = false;
+  return pdTRUE;
+}
@@ -0,0 +1,106 @@
+#include "mbed.h"
+#include "sim.h"
+
+SimLM75B simSensor[SIM_SENSORS];
+unsigned long simWrites, simReads, simNacks, simBits;
+double simUs = 0;
+double simConvUs = 100000;
+
+void simReset(void)
+{
+  for (uint8_t i = 0; i < SIM_SENSORS; i++)
+  {
+    // Power-on state: pointer on the temperature, THYST 75 °C, TOS 80 °C
+    simSensor[i].present = i == 0;
+    simSensor[i].pointer = 0;
+    simSensor[i].conf = 0;
+    simSensor[i].temp = 0;
+    simSensor[i].physical = 0;
+    simSensor[i].awake = -1e300; // converting since long ago
+    simSensor[i].thyst = 0x4B00;
+    simSensor[i].tos = 0x5000;
+  }
+  simWrites = simReads = simNacks = simBits = 0;
+}
+
+double simBusUs(void)
+{
+  return simBits * 1e6 / SIM_I2C_HZ;
+}
+
+void simSetTemp(uint8_t i, int16_t raw)
+{
+  simSensor[i].physical = raw;
+}
+
+uint16_t simTempRegister(SimLM75B *d)
+{
+  // Conversions run while the sensor is awake, the first one completes simConvUs after waking;
+  // in shutdown the register keeps the last result
+  if (!(d->conf & 1) && simUs - d->awake >= simConvUs)
+    d->temp = (uint16_t)(d->physical << 5);
+  return d->temp;
+}
+
+static SimLM75B *device(int address, int length)
+{
+  // START, address byte and its ACK, then 9 bits per data byte, STOP; the polled driver waits for all of it
+  int i = (address >> 1) - 0x48;
+  int n = 1 + 9 + 1;
+  SimLM75B *d = NULL;
+  if (i < 0 || i >= SIM_SENSORS || !simSensor[i].present)
+    simNacks++; // nothing follows the NACKed address
+  else
+  {
+    n += 9 * length;
+    d = &simSensor[i];
+  }
+  simBits += n;
+  simUs += n * 1e6 / SIM_I2C_HZ;
+  return d;
+}
+
+static uint16_t *reg16(SimLM75B *d, uint8_t reg)
+{
+  switch (reg)
+  {
+    case 0: return &d->temp;
+    case 2: return &d->thyst;
+    case 3: return &d->tos;
+    default: return NULL;
+  }
+}
+
+int I2C::write(int address, const char *data, int length, bool repeated)
+{
+  simWrites++;
+  SimLM75B *d = device(address, length);
+  if (d == NULL) return 1;
+  if (length == 0) return 0; // probe
+  d->pointer = data[0];
+  if (length == 2 && d->pointer == 1)
+  {
+    if ((d->conf & 1) && !(data[1] & 1)) d->awake = simUs; // out of shutdown: a new conversion starts
+    if (!(d->conf & 1) && (data[1] & 1)) simTempRegister(d); // into shutdown: keeps the last result
+    d->conf = data[1];
+  }
+  else if (length == 3 && d->pointer != 0 && reg16(d, d->pointer) != NULL)
+    *reg16(d, d->pointer) = ((uint8_t)data[1] << 8) | (uint8_t)data[2];
+  return 0;
+}
+
+int I2C::read(int address, char *data, int length, bool repeated)
+{
+  simReads++;
+  SimLM75B *d = device(address, length);
+  if (d == NULL) return 1;
+  for (int i = 0; i < length; i++)
+  {
+    // The configuration register repeats, the 16-bit ones send MSB then LSB
+    uint16_t *r = reg16(d, d->pointer);
+    if (d->pointer == 0) simTempRegister(d);
+    if (d->pointer == 1) data[i] = d->conf;
+    else data[i] = i % 2 == 0 ? (r ? *r : 0xFFFF) >> 8 : (r ? *r : 0xFFFF) & 0xFF;
+  }
+  return 0;
+}
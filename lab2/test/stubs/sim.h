@@ -0,0 +1,46 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Simulated I2C bus with up to 8 LM75B (addresses 0x48..0x4F). Every
+// transaction is counted and its bus time accumulated at SIM_I2C_HZ, so a
+// test can compare drivers by transactions, bytes and microseconds.
+//
+// The interrupt-driven path (acq.cpp) runs against a model of the LPC1768
+// I2C2 controller and ADC in simulated time: simRun() advances simUs event
+// by event (bit times on the bus, ADC conversions, the Ticker) and calls
+// acqI2CHandler/acqADCHandler as the NVIC would, until a task notification
+// is pending. xTaskNotifyWait (stubs/rtos.cpp) is where the task "sleeps".
+
+#include <stdint.h>
+
+#define SIM_SENSORS 8
+#define SIM_I2C_HZ  400000 // mbed I2C is set to 400 kHz by the firmware
+
+typedef struct
+{
+  bool present;
+  uint8_t pointer;       // register selected by the last write
+  uint8_t conf;
+  uint16_t temp, thyst, tos; // left-aligned as on the chip (temp: 11 bits, thyst/tos: 9 bits)
+  int16_t physical;      // temperature the next conversion will measure (0.125 °C steps)
+  double awake;          // simUs when it last left shutdown
+} SimLM75B;
+
+extern SimLM75B simSensor[SIM_SENSORS];
+extern unsigned long simWrites, simReads, simNacks; // transactions (a NACKed one is counted in simNacks too)
+extern unsigned long simBits;                        // bits clocked on the bus, START and STOP included
+
+void simReset(void);             // sensor 0 present, power-on registers, counters cleared
+double simBusUs(void);           // simBits at SIM_I2C_HZ
+void simSetTemp(uint8_t i, int16_t raw); // temperature at sensor i, raw in 0.125 °C steps
+uint16_t simTempRegister(SimLM75B *d);   // temperature register as read now
+
+extern double simUs;                // simulated time, microseconds (the polled I2C advances it too)
+extern double simConvUs;            // LM75B conversion time after leaving shutdown
+extern double simAdcUs;             // ADC conversion time (65 clocks at 13 MHz by default)
+extern uint16_t (*simAdcInput)(void); // 12-bit input of each conversion
+extern bool simNotified;            // a task notification is pending (set by the ISRs through rtos.cpp)
+
+void simRun(double until);          // run the hardware until a notification is pending or simUs reaches until
+
+#endif
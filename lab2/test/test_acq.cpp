@@ -0,0 +1,71 @@
+// acq.cpp against the simulated LPC1768 I2C2 controller and ADC: end-to-end
+// sample latency with the I2C read and the ADC conversion overlapped, against
+// running them one after the other, for several device latencies.
+
+#include <stdio.h>
+#include "mbed.h"
+#include "acq.h"
+#include "sim.h"
+#include "check.h"
+
+static const uint8_t address[1] = {0x48 << 1};
+static uint16_t input = 0xABC;
+static uint16_t adcInput(void) { return input; }
+
+static double sample(uint8_t what, short *temp, uint16_t *adc, bool *ok)
+{
+  double t0 = simUs;
+  acqStart(what);
+  *ok = acqWait(temp, adc);
+  return simUs - t0;
+}
+
+int main(void)
+{
+  short temp = 0;
+  uint16_t adc = 0;
+  bool ok;
+  
+  simReset();
+  simAdcInput = adcInput;
+  acqInit((TaskHandle_t)1, address, 1);
+  
+  // Values: LM75B register to Q3, 12-bit ADC to 16 bits as AnalogIn::read_u16()
+  for (int raw = -55 * 8; raw <= 125 * 8; raw += 3)
+  {
+    simSetTemp(0, raw);
+    input = (raw + 440) * 2;
+    sample(ACQ_TEMP | ACQ_LUM, &temp, &adc, &ok);
+    EXPECT(ok && temp == raw, "temp %d, expected %d", temp, raw);
+    EXPECT(adc == ((input << 4) | (input >> 8)), "adc 0x%04x for 0x%03x", adc, input);
+  }
+  
+  // Latency: the device times are the stand-ins, the notification wakes the task
+  printf("ADC conversion   T only    L only    T and L overlapped   one after the other\n");
+  const double adcUs[] = {65 / 13.0, 50, 75, 200, 1000};
+  for (unsigned i = 0; i < sizeof adcUs / sizeof adcUs[0]; i++)
+  {
+    simAdcUs = adcUs[i];
+    double t = sample(ACQ_TEMP, &temp, &adc, &ok);
+    double l = sample(ACQ_LUM, &temp, &adc, &ok);
+    double both = sample(ACQ_TEMP | ACQ_LUM, &temp, &adc, &ok);
+    printf("%8.1f us  %8.1f us %8.1f us %12.1f us %18.1f us\n", adcUs[i], t, l, both, t + l);
+    EXPECT(ok, "sample failed");
+    EXPECT(both <= (t > l ? t : l) + 0.01, "T and L not overlapped: %.1f us, %.1f and %.1f alone", both, t, l);
+  }
+  
+  // A sensor that doesn't answer keeps its previous value, a stuck device times out
+  simAdcUs = 65 / 13.0;
+  simSetTemp(0, 200);
+  sample(ACQ_TEMP, &temp, &adc, &ok);
+  simSensor[0].present = false;
+  simSetTemp(0, 100);
+  sample(ACQ_TEMP, &temp, &adc, &ok);
+  EXPECT(ok && temp == 200, "missing sensor: ok %d, temp %d", ok, temp);
+  simSensor[0].present = true;
+  simAdcUs = (ACQ_TIMEOUT + 5) * 1000.0;
+  double timeout = sample(ACQ_LUM, &temp, &adc, &ok);
+  EXPECT(!ok && timeout >= ACQ_TIMEOUT * 1000.0 && timeout < (ACQ_TIMEOUT + 1) * 1000.0, "timeout after %.1f us, ok %d", timeout, ok);
+  
+  return checkDone();
+}
@@ -0,0 +1,101 @@
+// agg.h kernels against the per-record loop they replaced: same min, max,
+// weighted sum and weight for random columns of every length, and time per
+// sample across record counts (the kernel keeps its running values in locals
+// instead of the accumulator, and measures faster at every count).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "agg.h"
+#include "check.h"
+
+template <typename V, typename S>
+static void scalar(Agg<V, S> *a, const V *value, const uint32_t *weight, uint8_t n)
+{
+  // What vTaskProcessing did per record before the kernel
+  for (uint8_t i = 0; i < n; i++)
+  {
+    if (a->empty || value[i] < a->min) a->min = value[i];
+    if (a->empty || value[i] > a->max) a->max = value[i];
+    a->sum += (S)value[i] * weight[i];
+    a->weight += weight[i];
+    a->empty = false;
+  }
+}
+
+template <typename V, typename S>
+static bool same(const Agg<V, S> &a, const Agg<V, S> &b)
+{
+  if (a.empty || b.empty) return a.empty == b.empty;
+  return a.min == b.min && a.max == b.max && a.sum == b.sum && a.weight == b.weight;
+}
+
+#define MAX_N 255
+static Temp t[MAX_N];
+static uint8_t l[MAX_N];
+static uint32_t w[MAX_N];
+
+static void fill(uint8_t n)
+{
+  for (uint8_t i = 0; i < n; i++)
+  {
+    t[i] = rand() % (183 * 8) - 55 * 8; // LM75B range
+    l[i] = rand() % 4;
+    w[i] = rand() % 100000;
+  }
+}
+
+int main(void)
+{
+  // Every length, with merges into an accumulator that already holds samples
+  for (int rep = 0; rep < 2000; rep++)
+  {
+    uint8_t n = rep % (MAX_N + 1);
+    fill(n);
+    AggT kt, st;
+    AggL kl, sl;
+    aggInit(&kt); aggInit(&st); aggInit(&kl); aggInit(&sl);
+    if (rep % 3 == 0)
+    {
+      aggMerge(&kt, (Temp)-5, (Temp)7, (int64_t)11, 3); aggMerge(&st, (Temp)-5, (Temp)7, (int64_t)11, 3);
+      aggMerge(&kl, (uint8_t)1, (uint8_t)2, (uint64_t)4, 3); aggMerge(&sl, (uint8_t)1, (uint8_t)2, (uint64_t)4, 3);
+    }
+    aggT(&kt, t, w, n); scalar(&st, t, w, n);
+    aggL(&kl, l, w, n); scalar(&sl, l, w, n);
+    EXPECT(same(kt, st), "aggT n=%u: min %d max %d sum %lld, expected %d %d %lld", n, kt.min, kt.max,
+           (long long)kt.sum, st.min, st.max, (long long)st.sum);
+    EXPECT(same(kl, sl), "aggL n=%u: min %u max %u sum %llu, expected %u %u %llu", n, kl.min, kl.max,
+           (unsigned long long)kl.sum, sl.min, sl.max, (unsigned long long)sl.sum);
+  }
+  
+  // Time per sample, T and L columns together as pr does, in AGG_CHUNK blocks and whole
+  printf("records   kernel (ns/sample)   per record (ns/sample)\n");
+  const uint8_t counts[] = {AGG_CHUNK, NR, 64, MAX_N};
+  for (unsigned c = 0; c < sizeof counts / sizeof counts[0]; c++)
+  {
+    uint8_t n = counts[c];
+    int reps = 20000000 / n;
+    fill(n);
+    AggT at; AggL al;
+    aggInit(&at); aggInit(&al);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+    {
+      aggT(&at, t, w, n);
+      aggL(&al, l, w, n);
+      __asm__ volatile("" : : "r"(&at), "r"(&al) : "memory");
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+    {
+      scalar(&at, t, w, n);
+      scalar(&al, l, w, n);
+      __asm__ volatile("" : : "r"(&at), "r"(&al) : "memory");
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    printf("%5u %16.2f %24.2f\n", n, std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)reps * n),
+           std::chrono::duration<double, std::nano>(t2 - t1).count() / ((double)reps * n));
+  }
+  
+  return checkDone();
+}
@@ -0,0 +1,67 @@
+// Up to 8 LM75B on the simulated bus: one acq batch (repeated STARTs, no
+// pointer writes) against polling each sensor with the driver, per number of
+// sensors, with the time budget of one tick. Absent sensors are skipped.
+
+#include <stdio.h>
+#include "mbed.h"
+#include "LM75B.h"
+#include "acq.h"
+#include "shared.h"
+#include "sim.h"
+#include "check.h"
+
+int main(void)
+{
+  uint8_t address[ACQ_MAX_SENSORS];
+  LM75B *sensor[ACQ_MAX_SENSORS];
+  short temp[ACQ_MAX_SENSORS];
+  const double tickUs = 1e6 / configTICK_RATE_HZ;
+  
+  simReset();
+  for (uint8_t i = 0; i < ACQ_MAX_SENSORS; i++)
+  {
+    simSensor[i].present = true;
+    simSetTemp(i, 160 + 8 * i); // 20 °C + i
+    address[i] = LM75B::ADDRESS_0 + (i << 1);
+    sensor[i] = new LM75B(p28, p27, (LM75B::Address)address[i]);
+    sensor[i]->open();
+    sensor[i]->temp_raw(); // pointer on REG_TEMP, as registerSensors() leaves it
+  }
+  
+  printf("sensors   batch (acq)   polled driver   tick\n");
+  for (uint8_t n = 1; n <= ACQ_MAX_SENSORS; n++)
+  {
+    acqInit((TaskHandle_t)1, address, n);
+    double t0 = simUs;
+    acqStart(ACQ_TEMP);
+    bool ok = acqWait(temp, NULL);
+    double batch = simUs - t0;
+    simRun(simUs + 100); // let the STOP go out
+    for (uint8_t i = 0; i < n; i++)
+      EXPECT(ok && temp[i] == 160 + 8 * i, "%u sensors: channel %u = %d", n, i, temp[i]);
+    
+    t0 = simUs;
+    for (uint8_t i = 0; i < n; i++) sensor[i]->temp_raw();
+    double polled = simUs - t0;
+    
+    printf("%4u %12.1f us %12.1f us %8.0f us\n", n, batch, polled, tickUs);
+    EXPECT(batch < tickUs, "%u sensors don't fit in one tick: %.1f us", n, batch);
+  }
+  
+  // Holes in the address range: absent sensors keep their previous value, the others are read
+  for (uint8_t i = 0; i < ACQ_MAX_SENSORS; i++)
+  {
+    temp[i] = -1;
+    simSetTemp(i, 240 + i);
+  }
+  simSensor[2].present = simSensor[5].present = false;
+  acqStart(ACQ_TEMP);
+  bool ok = acqWait(temp, NULL);
+  for (uint8_t i = 0; i < ACQ_MAX_SENSORS; i++)
+  {
+    short want = (i == 2 || i == 5) ? -1 : 240 + i;
+    EXPECT(ok && temp[i] == want, "with holes: channel %u = %d, expected %d", i, temp[i], want);
+  }
+  
+  return checkDone();
+}
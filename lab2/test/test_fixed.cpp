@@ -0,0 +1,105 @@
+// Fixed-point T pipeline (Q3 Temp, stats.h, integer PWM widths) against the
+// float one it replaced, per sample over pr passes of NR weighted records:
+// accuracy against a double reference and time on the host. The host has an FPU; the Cortex-M3 doesn't, so there
+// every float operation of the second loop is a library call.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "shared.h"
+#include "stats.h"
+#include "check.h"
+
+#define N (NR * 50000)
+static short raw[N];       // LM75B readings, 0.125 °C steps
+static uint32_t weight[N];
+
+static volatile int32_t sinkI;
+static volatile float sinkF;
+
+static int32_t widthFixed(Temp temp)
+{
+  // vTaskProcessing: blue pulse width from the mean T
+  if (temp < 0) temp = 0;
+  if (temp > TEMP_C(50)) temp = TEMP_C(50);
+  return PWM_PERIOD_US * temp / TEMP_C(50);
+}
+
+int main(void)
+{
+  // Random walk over the LM75B range
+  int v = 200;
+  for (int i = 0; i < N; i++)
+  {
+    v += rand() % 9 - 4;
+    if (v < -55 * 8) v = -55 * 8;
+    if (v > 125 * 8) v = 125 * 8;
+    raw[i] = v;
+    weight[i] = 500 + rand() % 1000; // ms each record was held
+  }
+  
+  // pr passes: NR records each, weighted by the ticks they were held
+  double fixedNs = 0, floatNs = 0, meanErr = 0, sdErr = 0, floatErr = 0;
+  for (int p = 0; p < N; p += NR)
+  {
+    double sw = 0, sum = 0, sum2 = 0;
+    for (int i = p; i < p + NR; i++)
+    {
+      double t = raw[i] / 8.0;
+      sw += weight[i]; sum += weight[i] * t; sum2 += weight[i] * t * t;
+    }
+    double mean = sum / sw, sd = sqrt(sum2 / sw - mean * mean);
+    
+    // Fixed: the Temp is the register value, weighted Welford in Q7, integer width
+    auto t0 = std::chrono::steady_clock::now();
+    Welford w;
+    welfordInit(&w);
+    for (int i = p; i < p + NR; i++)
+    {
+      Temp t = raw[i];
+      welfordAdd(&w, t, weight[i]);
+      sinkI = widthFixed(t);
+    }
+    int32_t fixedSdQ3 = welfordStddev(&w);
+    auto t1 = std::chrono::steady_clock::now();
+    
+    // Float: temp() = raw * 0.125, weighted running mean and variance, float duty cycle
+    float fw = 0, fmean = 0, fs = 0;
+    for (int i = p; i < p + NR; i++)
+    {
+      float t = raw[i] * 0.125f;
+      fw += weight[i];
+      float d = t - fmean;
+      fmean += d * weight[i] / fw;
+      fs += weight[i] * d * (t - fmean);
+      float r = 1 - t / 50.0f;
+      sinkF = r < 0 ? 0 : r > 1 ? 1 : r;
+    }
+    sinkF = sqrtf(fs / fw);
+    auto t2 = std::chrono::steady_clock::now();
+    
+    fixedNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    floatNs += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    double e = fabs(w.mean / (double)(1 << (TEMP_Q + WELFORD_FRAC)) - mean);
+    if (e > meanErr) meanErr = e;
+    e = fabs(fixedSdQ3 / 8.0 - sd);
+    if (e > sdErr) sdErr = e;
+    e = fabs(fmean - mean);
+    if (e > floatErr) floatErr = e;
+  }
+  printf("%d pr passes of %d records, worst error against double:\n", N / NR, NR);
+  printf("fixed  mean %.4f °C  sd %.4f °C  %.2f ns/sample\n", meanErr, sdErr, fixedNs / N);
+  printf("float  mean %.4f °C              %.2f ns/sample (host FPU)\n", floatErr, floatNs / N);
+  EXPECT(meanErr <= 0.125, "fixed mean off by %.4f", meanErr); // within one LM75B step
+  EXPECT(sdErr <= 0.125, "fixed sd off by %.4f", sdErr);
+  
+  // Pulse width: exact integer against the float duty cycle (1 us resolution)
+  for (int q = -10 * 8; q <= 60 * 8; q++)
+  {
+    double duty = q < 0 ? 0 : q > 400 ? 1 : q / 400.0;
+    EXPECT(abs(widthFixed(q) - (int)(PWM_PERIOD_US * duty)) <= 1, "width %d at %d", widthFixed(q), q);
+  }
+  
+  return checkDone();
+}
@@ -0,0 +1,118 @@
+// fmt.h against snprintf: same text for every value the firmware formats,
+// time per call, and stack used by each path (painted stack, libc included).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <ucontext.h>
+#include "fmt.h"
+#include "check.h"
+
+static void expect(const char *got, const char *want, const char *what, long value)
+{
+  if (strcmp(got, want) == 0) return;
+  if (failures++ < 10)
+    printf("FAIL %s(%ld): \"%s\", expected \"%s\"\n", what, value, got, want);
+}
+
+static void testOutput(void)
+{
+  char buf[32], ref[32];
+  
+  for (uint32_t v = 0; v < 1000000; v++)
+  {
+    fmtUint(buf, v); snprintf(ref, sizeof ref, "%u", (unsigned)v);
+    expect(buf, ref, "fmtUint", v);
+  }
+  fmtUint(buf, 4294967295u);
+  expect(buf, "4294967295", "fmtUint", 4294967295u);
+  for (uint8_t v = 0; v < 100; v++)
+  {
+    fmtUint2(buf, v); snprintf(ref, sizeof ref, "%02u", v);
+    expect(buf, ref, "fmtUint2", v);
+  }
+  for (long t = 0; t < 86400; t++)
+  {
+    // The end pointer is used to chain calls: check it too
+    char *end = fmtTime(buf, t / 3600, t / 60 % 60, t % 60);
+    snprintf(ref, sizeof ref, "%02u:%02u:%02u", (unsigned)(t / 3600), (unsigned)(t / 60 % 60), (unsigned)(t % 60));
+    expect(buf, ref, "fmtTime", t);
+    if (end != buf + 8) expect("end", "buf + 8", "fmtTime", t);
+  }
+  for (long t = -100000; t <= 100000; t++)
+  {
+    fmtTenths(buf, t); snprintf(ref, sizeof ref, "%.1f", t / 10.0);
+    expect(buf, ref, "fmtTenths", t);
+  }
+  for (long q = -55 * 8; q <= 150 * 8; q++) // LM75B range, Q3
+  {
+    // Half away from zero, as fmtQ3 documents (printf would round half to even on .25/.75)
+    fmtQ3(buf, q); snprintf(ref, sizeof ref, "%.1f", lround(q * 1.25) / 10.0);
+    expect(buf, ref, "fmtQ3", q);
+  }
+}
+
+// Formatting done by TaskClock (hh:mm:ss) and TaskSensors (T with one decimal), both ways
+static volatile char sink;
+
+__attribute__((noinline)) static void withFmt(void)
+{
+  char buf[FMT_TIME_LEN + 8];
+  fmtTime(buf, 23, 59, 58);
+  sink = buf[7];
+  fmtQ3(buf, 189);
+  sink = buf[3];
+}
+
+__attribute__((noinline)) static void withPrintf(void)
+{
+  char buf[FMT_TIME_LEN + 8];
+  snprintf(buf, sizeof buf, "%02u:%02u:%02u", 23, 59, 58);
+  sink = buf[7];
+  snprintf(buf, sizeof buf, "%.1f", 189 / 8.0);
+  sink = buf[3];
+}
+
+static double nsPerCall(void (*f)(void))
+{
+  const int n = 1000000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++) f();
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+}
+
+static char stack[64 * 1024];
+static ucontext_t caller, callee;
+static void (*probe)(void);
+
+static void runProbe(void) { probe(); }
+
+static unsigned stackUsed(void (*f)(void))
+{
+  // Run f on a painted stack and count the bytes it overwrote
+  memset(stack, 0xA5, sizeof stack);
+  getcontext(&callee);
+  callee.uc_stack.ss_sp = stack;
+  callee.uc_stack.ss_size = sizeof stack;
+  callee.uc_link = &caller;
+  probe = f;
+  makecontext(&callee, runProbe, 0);
+  swapcontext(&caller, &callee);
+  unsigned i = 0;
+  while (i < sizeof stack && stack[i] == (char)0xA5) i++;
+  return sizeof stack - i;
+}
+
+int main(void)
+{
+  testOutput();
+  
+  unsigned base = stackUsed([]{}); // context switch and runProbe itself
+  printf("hh:mm:ss + T.t with fmt:    %6.1f ns, %5u bytes of stack\n", nsPerCall(withFmt), stackUsed(withFmt) - base);
+  printf("hh:mm:ss + T.t with printf: %6.1f ns, %5u bytes of stack\n", nsPerCall(withPrintf), stackUsed(withPrintf) - base);
+  
+  return checkDone();
+}
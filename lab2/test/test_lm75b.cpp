@@ -0,0 +1,72 @@
+// LM75B driver on the simulated bus: I2C transactions and bus time per
+// temperature sample with the cached pointer register, against the
+// original write-pointer-then-read sequence, and temp_raw() over the range.
+
+#include <stdio.h>
+#include "LM75B.h"
+#include "sim.h"
+#include "check.h"
+
+// The original driver: every read selects the register first
+static short uncachedTempRaw(I2C &i2c)
+{
+  char buff[2] = {0, 0};
+  i2c.write(LM75B::ADDRESS_0, buff, 1);
+  i2c.read(LM75B::ADDRESS_0, buff, 2);
+  short value = (short)(((uint8_t)buff[0] << 8) | (uint8_t)buff[1]) >> 5;
+  return value;
+}
+
+int main(void)
+{
+  const int n = 1000;
+  
+  simReset();
+  LM75B sensor(p28, p27);
+  EXPECT(sensor.open(), "open() on a present sensor");
+  
+  // Samples as TaskSensors takes them: only the temperature register
+  simWrites = simReads = simBits = 0;
+  for (int i = 0; i < n; i++) sensor.temp_raw();
+  unsigned long cached = simWrites + simReads;
+  double cachedUs = simBusUs();
+  EXPECT(simWrites == 1 && simReads == n, "cached: %lu writes, %lu reads, expected 1 and %d", simWrites, simReads, n);
+  
+  I2C i2c(p28, p27);
+  simWrites = simReads = simBits = 0;
+  for (int i = 0; i < n; i++) uncachedTempRaw(i2c);
+  unsigned long uncached = simWrites + simReads;
+  double uncachedUs = simBusUs();
+  
+  printf("per sample  cached: %.3f transactions, %.1f us   uncached: %.3f transactions, %.1f us\n",
+         (double)cached / n, cachedUs / n, (double)uncached / n, uncachedUs / n);
+  // Transactions halve; bus time drops by the pointer write's 20 bits out of 49
+  EXPECT(cached == n + 1 && uncached == 2 * n, "transactions: %lu cached, %lu uncached", cached, uncached);
+  EXPECT(cachedUs < 0.6 * uncachedUs, "bus time %.1f us against %.1f us", cachedUs / n, uncachedUs / n);
+  
+  // Another register moves the pointer: the next sample selects REG_TEMP again, once
+  sensor.alertTemp(30.0);
+  simWrites = simReads = 0;
+  sensor.temp_raw(); sensor.temp_raw();
+  EXPECT(simWrites == 1 && simReads == 2, "after alertTemp: %lu writes, %lu reads", simWrites, simReads);
+  EXPECT(sensor.alertTemp() == 30.0f, "alertTemp read back %f", sensor.alertTemp());
+  
+  // A NACKed pointer write leaves the pointer unknown, so it is written again next time
+  simSensor[0].present = false;
+  sensor.powerMode(LM75B::POWER_SHUTDOWN);
+  simSensor[0].present = true;
+  simWrites = 0;
+  sensor.temp_raw();
+  EXPECT(simWrites == 1, "after a NACK: %lu pointer writes, expected 1", simWrites);
+  
+  // Whole LM75B range in 0.125 °C steps, the sign extension included
+  for (int raw = -55 * 8; raw <= 125 * 8; raw++)
+  {
+    simSetTemp(0, raw);
+    short got = sensor.temp_raw();
+    EXPECT(got == raw, "temp_raw() = %d, expected %d", got, raw);
+    EXPECT(sensor.temp() == raw * 0.125f, "temp() = %f, expected %f", sensor.temp(), raw * 0.125);
+  }
+  
+  return checkDone();
+}
@@ -0,0 +1,83 @@
+// Oversampled luminosity (acq.cpp, filter on): output of the two-stage
+// decimating filter for steady, noisy and stepped inputs on the simulated
+// ADC, and the cost of the ADC interrupt per input sample.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "mbed.h"
+#include "acq.h"
+#include "sim.h"
+#include "check.h"
+
+extern "C" void acqADCHandler(void);
+
+static int level = 2000, noise = 0; // 12-bit input and +-noise counts
+static uint16_t adcInput(void)
+{
+  int v = level + (noise ? rand() % (2 * noise + 1) - noise : 0);
+  return v < 0 ? 0 : v > 4095 ? 4095 : v;
+}
+
+static uint16_t readLum(void)
+{
+  short temp;
+  uint16_t adc = 0;
+  acqStart(ACQ_LUM);
+  acqWait(&temp, &adc);
+  return adc;
+}
+
+int main(void)
+{
+  simReset();
+  simAdcInput = adcInput;
+  acqInit((TaskHandle_t)1, NULL, 0);
+  acqFilter(true);
+  
+  // Steady input: 16-bit output, 4 x the 12-bit input once primed (64 samples of 12 bits, >> 2)
+  simRun(simUs + 2 * LUM_DECIM * LUM_RATE_US);
+  uint16_t steady = readLum();
+  EXPECT(steady == level * 16, "steady %u, expected %u", steady, level * 16);
+  
+  // Noisy input: the spread of the output against single conversions
+  noise = 200;
+  double sum = 0, sum2 = 0, raw = 0, raw2 = 0;
+  const int n = 200;
+  for (int i = 0; i < n; i++)
+  {
+    simRun(simUs + LUM_DECIM * LUM_RATE_US);
+    double v = readLum() / 16.0;
+    sum += v; sum2 += v * v;
+    double r = adcInput();
+    raw += r; raw2 += r * r;
+  }
+  double sd = sqrt(sum2 / n - (sum / n) * (sum / n)), rawSd = sqrt(raw2 / n - (raw / n) * (raw / n));
+  printf("noise +-%d: single conversion sd %.1f, filtered sd %.2f (12-bit counts)\n", noise, rawSd, sd);
+  EXPECT(sd < rawSd / 8, "filtered sd %.2f against %.1f", sd, rawSd);
+  EXPECT(fabs(sum / n - level) < 2, "filtered mean %.1f, expected %d", sum / n, level);
+  
+  // Step: settles within LUM_TAPS decimated outputs
+  noise = 0;
+  level = 3000;
+  double t0 = simUs;
+  while (readLum() != level * 16 && simUs - t0 < 1e6)
+    simRun(simUs + LUM_RATE_US);
+  double settle = simUs - t0;
+  printf("step response: settled in %.0f ms (%d taps of %d ms)\n", settle / 1000, LUM_TAPS, LUM_DECIM * LUM_RATE_US / 1000);
+  EXPECT(settle <= (LUM_TAPS + 1) * LUM_DECIM * LUM_RATE_US, "settled in %.0f us", settle);
+  
+  // Kernel cost: the ADC interrupt with the filter on, called back to back
+  const int calls = 10000000;
+  auto b0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++)
+  {
+    LPC_ADC->ADDR4 = (1u << 31) | ((i & 0xFFF) << 4);
+    acqADCHandler();
+  }
+  auto b1 = std::chrono::steady_clock::now();
+  printf("filter ISR: %.2f ns per input sample on the host\n", std::chrono::duration<double, std::nano>(b1 - b0).count() / calls);
+  
+  return checkDone();
+}
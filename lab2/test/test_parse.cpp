@@ -0,0 +1,86 @@
+// parseTime over all 86,400 valid hh:mm:ss strings, then every single-byte
+// corruption of a sample of them, against a plain reference parser.
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "parse.h"
+#include "check.h"
+
+static bool reference(const char *s, Time *time)
+{
+  if (strlen(s) != 8 || s[2] != ':' || s[5] != ':') return false;
+  for (int i = 0; i < 8; i++)
+    if (i != 2 && i != 5 && !isdigit((unsigned char)s[i])) return false;
+  int h = (s[0] - '0') * 10 + s[1] - '0';
+  int m = (s[3] - '0') * 10 + s[4] - '0';
+  int sec = (s[6] - '0') * 10 + s[7] - '0';
+  if (h > 23 || m > 59 || sec > 59) return false;
+  *time = h * 3600 + m * 60 + sec;
+  return true;
+}
+
+static void check(const char *s)
+{
+  Time got = -1, want = -1;
+  char copy[16];
+  
+  strcpy(copy, s);
+  bool ok = parseTime(copy, &got);
+  bool ref = reference(s, &want);
+  if (ok != ref || (ok && got != want) || strcmp(copy, s) != 0)
+  {
+    if (failures++ < 10)
+    {
+      printf("FAIL \"");
+      for (const char *p = s; *p; p++) printf(isprint((unsigned char)*p) ? "%c" : "\\x%02x", (unsigned char)*p);
+      printf("\": %d %ld, expected %d %ld\n", ok, (long)got, ref, (long)want);
+    }
+  }
+}
+
+int main(void)
+{
+  char s[16];
+  long valid = 0, corrupted = 0;
+  
+  // Every valid time, seconds since midnight
+  for (long t = 0; t < 86400; t++)
+  {
+    Time got;
+    snprintf(s, sizeof s, "%02ld:%02ld:%02ld", t / 3600, t / 60 % 60, t % 60);
+    if (!parseTime(s, &got) || got != t)
+    {
+      if (failures++ < 10) printf("FAIL \"%s\": expected %ld\n", s, t);
+    }
+    valid++;
+  }
+  
+  // Each byte of a valid time replaced by every value (a '\0' cuts the string), and one byte appended
+  for (long t = 0; t < 86400; t += 37)
+  {
+    for (int i = 0; i <= 8; i++)
+      for (int c = 0; c < 256; c++)
+      {
+        snprintf(s, sizeof s, "%02ld:%02ld:%02ld", t / 3600, t / 60 % 60, t % 60);
+        s[i] = c;
+        if (i == 8) s[9] = '\0';
+        check(s);
+        corrupted++;
+      }
+  }
+  
+  // Malformed in other ways: out of range, short, long, signs and spaces
+  const char *malformed[] = {"", "1", "12:00", "1:00:00", "12:0:00", "12:00:0", "24:00:00", "23:60:00",
+                             "23:59:60", "99:99:99", "12:00:00 ", " 12:00:00", "+1:00:00", "-1:00:00",
+                             "12-00-00", "12:00:00:00", "1a:00:00", "12::00:00", "::::::::"};
+  for (unsigned i = 0; i < sizeof malformed / sizeof malformed[0]; i++)
+  {
+    Time got;
+    if (parseTime(malformed[i], &got) && failures++ < 10)
+      printf("FAIL \"%s\" accepted\n", malformed[i]);
+  }
+  
+  printf("%ld valid, %ld corrupted inputs\n", valid, corrupted);
+  return checkDone();
+}
@@ -0,0 +1,78 @@
+// One-shot power mode on the simulated LM75B, which only converts while awake
+// and needs simConvUs after leaving shutdown. TaskSensorTimer's schedule is
+// replayed: wake LM75B_CONV_MS before each T deadline, read at the deadline,
+// shut down again. The sample must be fresh and add no latency.
+
+#include <stdio.h>
+#include "LM75B.h"
+#include "shared.h"
+#include "sim.h"
+#include "check.h"
+
+// setSensorPower(), then the pointer back on the temperature register
+static void power(LM75B &sensor, bool awake)
+{
+  sensor.powerMode(awake ? LM75B::POWER_NORMAL : LM75B::POWER_SHUTDOWN);
+  sensor.temp_raw();
+}
+
+int main(void)
+{
+  simReset();
+  LM75B sensor(p28, p27);
+  sensor.open();
+  
+  printf("pmon      fresh samples   read latency   awake\n");
+  const double periods[] = {1, 5, 60}; // seconds
+  for (unsigned p = 0; p < sizeof periods / sizeof periods[0]; p++)
+  {
+    const int n = 20;
+    double period = periods[p] * 1e6, awake = 0, latency = 0;
+    int fresh = 0;
+    
+    power(sensor, 0);
+    for (int i = 1; i <= n; i++)
+    {
+      double deadline = i * period + p * 1e9; // each run starts later than the previous one
+      short expected = 200 + i * (p + 1);
+      simSetTemp(0, expected);                // the temperature changes while the sensor sleeps
+      
+      simUs = deadline - LM75B_CONV_MS * 1000.0;
+      double woken = simUs;
+      power(sensor, 1);
+      
+      simUs = deadline;
+      short t = sensor.temp_raw();
+      latency += simUs - deadline;
+      if (t == expected) fresh++;
+      
+      power(sensor, 0);
+      awake += simUs - woken;
+    }
+    printf("%4.0f s %12d/%d %11.1f us %8.2f %%\n", periods[p], fresh, n, latency / n, 100 * awake / (n * period));
+    EXPECT(fresh == n, "%d stale samples at pmon %.0f s", n - fresh, periods[p]);
+    EXPECT(latency / n < 1000, "the sample waited %.1f us", latency / n);
+  }
+  
+  // Read right after waking (no lead): still the value from before the shutdown
+  simSetTemp(0, 100);
+  power(sensor, 1);
+  simUs += 5e6;
+  power(sensor, 0);
+  simSetTemp(0, 300);
+  simUs += 5e6;
+  power(sensor, 1);
+  short stale = sensor.temp_raw();
+  EXPECT(stale == 100, "read right after waking gave %d, the model should hold 100", stale);
+  
+  // Not woken in advance (console read): TaskSensors waits one conversion, fresh but late
+  simUs += LM75B_CONV_MS * 1000.0;
+  short late = sensor.temp_raw();
+  EXPECT(late == 300, "after LM75B_CONV_MS: %d, expected 300", late);
+  
+  // The lead covers conversions up to LM75B_CONV_MS, not slower parts
+  printf("margin: conversions up to %d ms (%.0f ms modelled)\n", LM75B_CONV_MS, simConvUs / 1000);
+  EXPECT(simConvUs <= LM75B_CONV_MS * 1000.0, "LM75B_CONV_MS shorter than a conversion");
+  
+  return checkDone();
+}
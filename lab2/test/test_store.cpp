@@ -0,0 +1,90 @@
+// Record store (store.h) in the layout it is built with (RECORD_SOA, the
+// Makefile builds both): records read back as written, columns of the channels
+// asked for gathered across the ring wrap, and time per record of a pr scan
+// (AGG_CHUNK records at a time from every ring position, as vTaskProcessing
+// gathers them) with one channel and with all of them. SoA measures faster
+// with one channel and level with AoS (within noise) with all eight.
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "store.h"
+#include "agg.h"
+#include "check.h"
+
+static void make(Record *r, uint8_t i)
+{
+  r->stamp = 1000000007ull * (i + 1);
+  r->luminosity = i % 4;
+  for (uint8_t c = 0; c < NTS; c++) r->temperature[c] = (Temp)(i * 16 - c * 8 - 100);
+}
+
+int main(void)
+{
+  Record r, e;
+  Tick colS[AGG_CHUNK + 1];
+  Temp colT[NTS][AGG_CHUNK + 1];
+  uint8_t colL[AGG_CHUNK + 1];
+  
+  storeClear();
+  for (uint8_t i = 0; i < NR; i++) { make(&r, i); storeWrite(i, &r); }
+  for (uint8_t i = 0; i < NR; i++)
+  {
+    make(&e, i);
+    storeRead(i, &r);
+    bool same = r.stamp == e.stamp && r.luminosity == e.luminosity && storeStamp(i) == e.stamp;
+    for (uint8_t c = 0; c < NTS; c++) same = same && r.temperature[c] == e.temperature[c];
+    EXPECT(same, "record %u read back differently", i);
+  }
+  
+  // Every start, length and channel count, including the runs that wrap past NR - 1;
+  // the columns of channels not asked for are left alone
+  for (uint8_t nt = 1; nt <= NTS; nt++)
+    for (uint8_t i = 0; i < NR; i++)
+      for (uint8_t n = 0; n <= AGG_CHUNK; n++)
+      {
+        memset(colT, 0x55, sizeof(colT));
+        storeColumns(i, n, colS, &colT[0][0], AGG_CHUNK + 1, nt, colL);
+        for (uint8_t k = 0; k < n; k++)
+        {
+          make(&e, (i + k) % NR);
+          bool same = colS[k] == e.stamp && colL[k] == e.luminosity;
+          for (uint8_t c = 0; c < NTS; c++) same = same && colT[c][k] == (c < nt ? e.temperature[c] : 0x5555);
+          EXPECT(same, "%u channels from %u, n=%u: record %u differs", nt, i, n, k);
+        }
+      }
+  
+  storeClear();
+  storeRead(NR - 1, &r);
+  EXPECT(r.stamp == 0 && r.luminosity == 0 && r.temperature[NTS - 1] == 0, "storeClear left data");
+  
+  // pr scan: whole ring from every start, AGG_CHUNK records per gather, T of the channels in use summed
+  for (uint8_t i = 0; i < NR; i++) { make(&r, i); storeWrite(i, &r); }
+  const uint8_t nts[] = {1, NTS};
+  for (uint8_t j = 0; j < 2; j++)
+  {
+    uint8_t nt = nts[j];
+    const int reps = 500000;
+    int64_t sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < reps; rep++)
+    {
+      uint8_t i = rep % NR;
+      for (uint8_t done = 0, n; done < NR; done += n)
+      {
+        n = NR - done < AGG_CHUNK ? NR - done : AGG_CHUNK;
+        storeColumns((i + done) % NR, n, colS, &colT[0][0], AGG_CHUNK + 1, nt, colL);
+        for (uint8_t c = 0; c < nt; c++)
+          for (uint8_t k = 0; k < n; k++) sum += colT[c][k];
+      }
+      __asm__ volatile("" : : "r"(colT) : "memory");
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    printf("RECORD_SOA %d, %u channel(s): %.2f ns/record scanned (checksum %lld)\n", RECORD_SOA, nt,
+           std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)reps * NR), (long long)sum);
+  }
+  unsigned bytes = RECORD_SOA ? sizeof(Tick) + NTS * sizeof(Temp) + 1 : sizeof(Record); // no padding per field column
+  printf("RECORD_SOA %d: %u bytes stored per record\n", RECORD_SOA, bytes);
+  
+  return checkDone();
+}
@@ -0,0 +1,119 @@
+// Online trend (trend.h) against a double least-squares fit and EWMA recomputed
+// over the same window: exact slopes on ramps, no drift of the running sums
+// across days of stamps (base moves), EWMA of negative temperatures, and time
+// per sample early and late in the run (it must not grow).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "FreeRTOS.h"
+#include "trend.h"
+#include "check.h"
+
+// trendRead's critical section: a single thread here
+extern "C" void vPortEnterCritical(void) {}
+extern "C" void vPortExitCritical(void) {}
+
+static Tick now = 0;
+static Tick winS[TREND_N];
+static Temp winT[NTS][TREND_N];
+static int wcount = 0, wpos = 0;
+static double ref[NTS];
+
+static void add(Tick step, const Temp *temp)
+{
+  // One sample to trendAdd and to the reference window
+  now += step;
+  trendAdd(now, temp, NTS);
+  winS[wpos] = now;
+  for (uint8_t c = 0; c < NTS; c++)
+  {
+    winT[c][wpos] = temp[c];
+    ref[c] = wcount == 0 ? temp[c] : ref[c] + (temp[c] - ref[c]) / (1 << TREND_SHIFT);
+  }
+  wpos = (wpos + 1) % TREND_N;
+  if (wcount < TREND_N) wcount++;
+}
+
+static int16_t slope(uint8_t c)
+{
+  // Least squares over the window, in tenths of °C per minute
+  double mt = 0, mx = 0, stt = 0, stx = 0;
+  for (int k = 0; k < wcount; k++) { mt += (double)(int64_t)(winS[k] - winS[0]); mx += winT[c][k]; }
+  mt /= wcount; mx /= wcount;
+  for (int k = 0; k < wcount; k++)
+  {
+    double t = (double)(int64_t)(winS[k] - winS[0]) - mt;
+    stt += t * t; stx += t * (winT[c][k] - mx);
+  }
+  double r = stt > 0 ? stx / stt * 60 * configTICK_RATE_HZ * 10 / 8 : 0;
+  return r > INT16_MAX ? INT16_MAX : r < -INT16_MAX ? -INT16_MAX : (int16_t)r;
+}
+
+int main(void)
+{
+  Temp temp[NTS], e[NTS];
+  int16_t r[NTS];
+  
+  // Constant below zero: EWMA exact, no slope
+  for (uint8_t c = 0; c < NTS; c++) temp[c] = -437;
+  for (int i = 0; i < 3 * TREND_N; i++) add(1000, temp);
+  trendRead(e, r, NTS);
+  EXPECT(e[0] == -437 && e[NTS - 1] == -437, "EWMA of -437: %d %d", e[0], e[NTS - 1]);
+  EXPECT(r[0] == 0 && trendRate() == 0, "constant: rate %d, highest %d", r[0], trendRate());
+  
+  // 1 °C per minute up on channel 0, down on channel 1 (one 0.125 °C step every 7.5 s)
+  for (int i = 0; i < TREND_N; i++)
+  {
+    temp[0]++; temp[1]--;
+    add(7500, temp);
+  }
+  trendRead(e, r, NTS);
+  EXPECT(r[0] == 10 && r[1] == -10 && r[2] == 0, "ramps: %d %d %d, expected 10 -10 0", r[0], r[1], r[2]);
+  EXPECT(trendRate() == 10, "highest rate %d, expected 10", trendRate());
+  
+  // Random walk with jittered periods over about three weeks of ticks (the base moves hundreds of times)
+  int worstR = 0, worstE = 0;
+  for (int i = 0; i < 2000000; i++)
+  {
+    for (uint8_t c = 0; c < NTS; c++)
+    {
+      int v = temp[c] + rand() % 5 - 2;
+      temp[c] = v < -55 * 8 ? -55 * 8 : v > 125 * 8 ? 125 * 8 : v;
+    }
+    add(200 + rand() % 1800, temp);
+    if (i % 97) continue;
+    trendRead(e, r, NTS);
+    for (uint8_t c = 0; c < NTS; c++)
+    {
+      int dr = abs(r[c] - slope(c)), de = abs(e[c] - (int)lround(ref[c]));
+      if (dr > worstR) worstR = dr;
+      if (de > worstE) worstE = de;
+    }
+  }
+  printf("%.1f days of ticks, worst slope error %d (0.1 °C/min), worst EWMA error %d (Q3)\n",
+         (double)now / configTICK_RATE_HZ / 86400, worstR, worstE);
+  EXPECT(worstR <= 1, "slope off by %d", worstR);
+  EXPECT(worstE <= 1, "EWMA off by %d", worstE);
+  
+  // Cost per sample of NTS channels, first and last half of a long run
+  const int reps = 4000000;
+  double ns[2];
+  for (int h = 0; h < 2; h++)
+  {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps / 2; i++)
+    {
+      temp[i % NTS] += (i & 2) - 1;
+      now += 1000;
+      trendAdd(now, temp, NTS);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    ns[h] = std::chrono::duration<double, std::nano>(t1 - t0).count() / (reps / 2);
+  }
+  printf("trendAdd of %d channels: %.1f ns/sample, then %.1f ns/sample\n", NTS, ns[0], ns[1]);
+  EXPECT(ns[1] < 2 * ns[0], "cost per sample grew from %.1f to %.1f ns", ns[0], ns[1]);
+  
+  return checkDone();
+}
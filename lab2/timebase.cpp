@@ -0,0 +1,74 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timebase.h"
+
+static int64_t offset = 0; // wall clock ticks (since midnight of day 0) minus tick count
+
+Tick tickNow(void)
+{
+  static TickType_t last = 0;
+  static uint32_t wraps = 0;
+  TickType_t now;
+  Tick tick;
+  
+  // CRITICAL SECTION: last and wraps are shared by every caller
+  taskENTER_CRITICAL();
+  now = xTaskGetTickCount();
+  if (now < last) wraps++; // TickType_t overflowed since the previous call
+  last = now;
+  tick = ((Tick)wraps << 32) | now;
+  taskEXIT_CRITICAL();
+  // END OF CRITICAL SECTION
+  return tick;
+}
+
+void setWallTime(Time time)
+{
+  int64_t now = tickNow();
+  
+  // CRITICAL SECTION: 64-bit stores are not atomic on the M3
+  taskENTER_CRITICAL();
+  offset = (int64_t)time * configTICK_RATE_HZ - now;
+  taskEXIT_CRITICAL();
+  // END OF CRITICAL SECTION
+}
+
+static Tick dayTicks(Tick tick)
+{
+  int64_t wall;
+  
+  // CRITICAL SECTION: 64-bit loads are not atomic on the M3
+  taskENTER_CRITICAL();
+  wall = (int64_t)tick + offset;
+  taskEXIT_CRITICAL();
+  // END OF CRITICAL SECTION
+  // Ticks since the last midnight (records taken before the clock was set back are negative)
+  wall %= (int64_t)TICKS_PER_DAY;
+  return wall < 0 ? wall + TICKS_PER_DAY : wall;
+}
+
+Time wallTime(Tick tick, uint16_t *ms)
+{
+  Tick day = dayTicks(tick);
+  
+  if (ms != NULL) *ms = day % configTICK_RATE_HZ * 1000 / configTICK_RATE_HZ;
+  return day / configTICK_RATE_HZ;
+}
+
+Tick wallToTick(Time time)
+{
+  Tick now = tickNow();
+  Tick day = dayTicks(now), at = (Tick)time * configTICK_RATE_HZ;
+  // How long ago the wall clock last read time (today, or yesterday if it's still ahead)
+  Tick ago = day >= at ? day - at : day + TICKS_PER_DAY - at;
+  
+  return ago <= now ? now - ago : 0;
+}
+
+Tick wallNext(Time time)
+{
+  Tick now = tickNow();
+  Tick day = dayTicks(now), at = (Tick)time * configTICK_RATE_HZ;
+  
+  return now + (at > day ? at - day : at + TICKS_PER_DAY - day);
+}
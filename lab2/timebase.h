@@ -0,0 +1,21 @@
+#include <cstdint>
+#include "FreeRTOS.h"
+#include "shared.h"
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+// Monotonic 64-bit timebase: the FreeRTOS tick count extended past the
+// TickType_t overflow. Records are stamped with it; the wall clock is an
+// offset against it and is only applied when a Tick is displayed or a
+// hh:mm:ss instant is turned into a Tick range.
+
+#define TICKS_PER_DAY ((Tick)86400 * configTICK_RATE_HZ)
+
+Tick tickNow(void);                    // ticks since boot (tasks only, at least once per TickType_t period)
+void setWallTime(Time time);           // the wall clock reads time (seconds since midnight) now
+Time wallTime(Tick tick, uint16_t *ms); // wall clock at tick, ms (if not NULL) gets the milliseconds
+Tick wallToTick(Time time);            // latest tick, not after now, at which the wall clock read time
+Tick wallNext(Time time);              // first tick after now at which the wall clock reads time
+
+#endif /* TIMEBASE_H */
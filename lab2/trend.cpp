@@ -0,0 +1,82 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "trend.h"
+
+#define REBASE ((Tick)1 << 22) // stamps are kept relative to a base, moved once they get this far
+
+static Tick stamps[TREND_N];
+static Temp values[NTS][TREND_N];
+static uint8_t count = 0, pos = 0;   // samples in the window, slot of the next one
+static Tick base = 0;
+static int64_t st = 0, stt = 0;      // sum of t, t^2 (t = stamp - base)
+static int64_t sx[NTS], stx[NTS];    // sum of x, t x per channel
+static int32_t ewma[NTS];            // Q3 with 8 more fraction bits
+static int16_t rate[NTS];            // tenths of °C per minute
+static int16_t highest = 0;
+
+void trendAdd(Tick stamp, const Temp *temp, uint8_t n)
+{
+  int64_t t, d, num, den, r;
+  int16_t top = 0;
+  
+  // The oldest sample leaves the sums
+  if (count == TREND_N)
+  {
+    t = stamps[pos] - base;
+    st -= t; stt -= t * t;
+    for (uint8_t c = 0; c < n; c++) { sx[c] -= values[c][pos]; stx[c] -= t * values[c][pos]; }
+  }
+  else count++;
+  // Move the base to the oldest sample kept, so t^2 and t x stay small
+  // (sum (t - d)^2 = sum t^2 - 2 d sum t + m d^2, sum (t - d) x = sum t x - d sum x)
+  if (stamp - base >= REBASE)
+  {
+    uint8_t m = count - 1;
+    d = (m > 0 ? stamps[(pos + TREND_N - m) % TREND_N] : stamp) - base;
+    stt += -2 * d * st + m * d * d;
+    st -= m * d;
+    for (uint8_t c = 0; c < n; c++) stx[c] -= d * sx[c];
+    base += d;
+  }
+  
+  // The newest one enters them
+  t = stamp - base;
+  stamps[pos] = stamp;
+  st += t; stt += t * t;
+  den = count * stt - st * st;
+  for (uint8_t c = 0; c < n; c++)
+  {
+    values[c][pos] = temp[c];
+    sx[c] += temp[c]; stx[c] += t * temp[c];
+    num = count * stx[c] - st * sx[c];
+    // EWMA (the first sample initializes it); scaled by multiplication and division, as
+    // shifts of negative values are undefined or implementation-defined
+    if (count == 1) ewma[c] = (int32_t)temp[c] * 256;
+    else ewma[c] += ((int32_t)temp[c] * 256 - ewma[c]) / (1 << TREND_SHIFT);
+    // Slope in Q3 per tick to tenths of °C per minute: x 60 s x configTICK_RATE_HZ x 10 / 8
+    r = den > 0 ? num * (60 * configTICK_RATE_HZ * 10 / 8) / den : 0;
+    rate[c] = r > INT16_MAX ? INT16_MAX : r < -INT16_MAX ? -INT16_MAX : r;
+    if (rate[c] > top) top = rate[c];
+    else if (-rate[c] > top) top = -rate[c];
+  }
+  pos = (pos + 1) % TREND_N;
+  highest = top;
+}
+
+int16_t trendRate(void)
+{
+  return highest;
+}
+
+void trendRead(Temp *e, int16_t *r, uint8_t n)
+{
+  // CRITICAL SECTION: TaskSensors may be updating them
+  taskENTER_CRITICAL();
+  for (uint8_t c = 0; c < n; c++)
+  {
+    e[c] = (ewma[c] + (ewma[c] < 0 ? -128 : 128)) / 256; // rounded half away from zero
+    r[c] = rate[c];
+  }
+  taskEXIT_CRITICAL();
+  // END OF CRITICAL SECTION
+}
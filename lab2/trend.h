@@ -0,0 +1,20 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef TREND_H
+#define TREND_H
+
+// Online trend of every T channel, updated in constant time per sample:
+// a fixed-point EWMA of the temperature, and the least-squares slope over
+// the last TREND_N samples from running sums (the oldest sample is
+// subtracted as the newest is added). Called by TaskSensors only; the
+// results are copied out in a critical section.
+
+#define TREND_N     16 // samples in the least-squares window
+#define TREND_SHIFT 3  // EWMA weight of a new sample: 1 / 2^TREND_SHIFT
+
+void trendAdd(Tick stamp, const Temp *temp, uint8_t n);  // one T sample of n channels
+int16_t trendRate(void);                                 // highest |slope| over the channels (tenths of °C per minute)
+void trendRead(Temp *ewma, int16_t *rate, uint8_t n);    // per channel, slope in tenths of °C per minute
+
+#endif /* TREND_H */
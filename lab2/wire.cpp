@@ -0,0 +1,16 @@
+#include "wire.h"
+
+uint8_t wireRecord(uint8_t *buf, const Record *record, uint8_t nts)
+{
+  uint8_t n = 0;
+  
+  for (uint8_t i = 0; i < 8; i++)
+    buf[n++] = (uint8_t)(record->stamp >> (8 * i));
+  buf[n++] = record->luminosity;
+  for (uint8_t c = 0; c < nts; c++)
+  {
+    buf[n++] = (uint8_t)((uint16_t)record->temperature[c]);
+    buf[n++] = (uint8_t)((uint16_t)record->temperature[c] >> 8);
+  }
+  return n;
+}
@@ -0,0 +1,20 @@
+#include <cstdint>
+#include "shared.h"
+
+#ifndef WIRE_H
+#define WIRE_H
+
+// Byte layout of a Record on the serial link (er binary frames and telemetry).
+// Fields are written one by one, so the layout does not depend on the struct
+// padding, the compiler or NTS:
+//   offset 0  stamp        uint64, little-endian (ticks since boot, 1 ms)
+//   offset 8  luminosity   uint8 (0..3)
+//   offset 9  temperature  nts x int16, little-endian (Q3: 1/8 °C), channel 0 first
+// Only the nts connected channels are sent, the host learns nts from the frame.
+
+#define WIRE_RECORD_LEN(n) (9 + 2 * (n))
+#define WIRE_RECORD_MAX WIRE_RECORD_LEN(NTS)
+
+uint8_t wireRecord(uint8_t *buf, const Record *record, uint8_t nts); // bytes written
+
+#endif /* WIRE_H */